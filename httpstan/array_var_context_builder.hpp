@@ -0,0 +1,127 @@
+#ifndef HTTPSTAN_ARRAY_VAR_CONTEXT_BUILDER_HPP
+#define HTTPSTAN_ARRAY_VAR_CONTEXT_BUILDER_HPP
+
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <stan/io/array_var_context.hpp>
+
+namespace httpstan {
+
+/**
+ * <code>array_var_context_builder</code> collects the arguments of the
+ * <code>array_var_context</code> constructor.
+ *
+ * Stan expects multi-dimensional data to be flattened in column-major order.
+ * Values may be added in either row-major (C) or column-major (Fortran)
+ * order. Row-major values are reordered while they are copied, in one pass.
+ */
+class array_var_context_builder {
+public:
+  std::vector<std::string> names_r;
+  std::vector<double> values_r;
+  std::vector<std::vector<size_t>> dim_r;
+  std::vector<std::string> names_i;
+  std::vector<int> values_i;
+  std::vector<std::vector<size_t>> dim_i;
+
+  /**
+   * Add a real-valued variable.
+   *
+   * @param[in] name variable name
+   * @param[in] values pointer to the first of the product of `dims` values
+   * @param[in] dims dimensions of the variable, empty for a scalar
+   * @param[in] column_major true if `values` are in column-major order
+   */
+  template <typename S>
+  void add_real(const std::string &name, const S *values, const std::vector<size_t> &dims, bool column_major) {
+    names_r.push_back(name);
+    dim_r.push_back(dims);
+    append_column_major(values, dims, column_major, values_r,
+                        [](S value) { return static_cast<double>(value); });
+  }
+
+  /**
+   * Add an integer-valued variable.
+   *
+   * Stan integers are 32-bit. A value which does not fit raises an exception.
+   *
+   * @param[in] name variable name
+   * @param[in] values pointer to the first of the product of `dims` values
+   * @param[in] dims dimensions of the variable, empty for a scalar
+   * @param[in] column_major true if `values` are in column-major order
+   */
+  template <typename S>
+  void add_int(const std::string &name, const S *values, const std::vector<size_t> &dims, bool column_major) {
+    names_i.push_back(name);
+    dim_i.push_back(dims);
+    append_column_major(values, dims, column_major, values_i, [&name](S value) {
+      if (value < std::numeric_limits<int>::min() || value > std::numeric_limits<int>::max())
+        throw std::domain_error("Value of integer variable `" + name + "` is out of range.");
+      return static_cast<int>(value);
+    });
+  }
+
+  /**
+   * Returns a pointer to a new array_var_context. Caller takes responsibility for deleting.
+   */
+  stan::io::array_var_context *build() const {
+    return new stan::io::array_var_context(names_r, values_r, dim_r, names_i, values_i, dim_i);
+  }
+
+  /**
+   * Returns an estimate of the memory used by an array_var_context built from these arguments, in bytes.
+   */
+  size_t size_in_bytes() const {
+    size_t size = sizeof(stan::io::array_var_context);
+    size += values_r.size() * sizeof(double) + values_i.size() * sizeof(int);
+    for (const std::string &name : names_r)
+      size += name.size();
+    for (const std::string &name : names_i)
+      size += name.size();
+    for (const std::vector<size_t> &dims : dim_r)
+      size += dims.size() * sizeof(size_t);
+    for (const std::vector<size_t> &dims : dim_i)
+      size += dims.size() * sizeof(size_t);
+    return size;
+  }
+
+private:
+  template <typename S, typename T, typename F>
+  static void append_column_major(const S *values, const std::vector<size_t> &dims, bool column_major,
+                                  std::vector<T> &output, F convert) {
+    size_t size = 1;
+    for (size_t dim : dims)
+      size *= dim;
+    output.reserve(output.size() + size);
+    if (column_major || dims.size() < 2) {
+      for (size_t n = 0; n < size; ++n)
+        output.push_back(convert(values[n]));
+      return;
+    }
+    // Walk the column-major index (first index fastest), tracking the row-major offset.
+    const size_t ndim = dims.size();
+    std::vector<size_t> strides(ndim, 1);
+    for (size_t d = ndim - 1; d > 0; --d)
+      strides[d - 1] = strides[d] * dims[d];
+    std::vector<size_t> index(ndim, 0);
+    size_t offset = 0;
+    for (size_t n = 0; n < size; ++n) {
+      output.push_back(convert(values[offset]));
+      for (size_t d = 0; d < ndim; ++d) {
+        if (++index[d] < dims[d]) {
+          offset += strides[d];
+          break;
+        }
+        offset -= strides[d] * (dims[d] - 1);
+        index[d] = 0;
+      }
+    }
+  }
+};
+
+} // namespace httpstan
+#endif // HTTPSTAN_ARRAY_VAR_CONTEXT_BUILDER_HPP
@@ -34,6 +34,19 @@ def fit_path(fit_name: str) -> Path:
     return cache_directory() / fit_directory / fit_filename
 
 
+def fit_summary_path(fit_name: str) -> Path:
+    """Get the path to the summary of a fit. File may not exist."""
+    # written alongside the fit by the process calling the stan::services function
+    path = fit_path(fit_name)
+    return path.with_name(path.name + ".summary.json")
+
+
+def fit_sketch_path(fit_name: str) -> Path:
+    """Get the path to the summary of a fit in the binary wire format, for merging. File may not exist."""
+    path = fit_path(fit_name)
+    return path.with_name(path.name + ".sketch")
+
+
 def delete_model_directory(model_name: str) -> None:
     """Delete the directory in which a model and associated fits are stored."""
     shutil.rmtree(model_directory(model_name), ignore_errors=True)
@@ -94,47 +107,69 @@ def load_stanc_warnings(model_name: str) -> str:
         return fh.read()
 
 
-def dump_fit(fit_bytes: bytes, name: str) -> None:
-    """Store Stan fit in filesystem-based cache.
-
-    The Stan fit is passed via ``fit_bytes``. The content
-    must already be compressed.
+def load_fit(name: str) -> bytes:
+    """Load Stan fit from the filesystem-based cache.
 
     Arguments:
         name: Stan fit name
-        fit_bytes: LZ4-compressed messages associated with Stan fit.
+        model_name: Stan model name
+
+    Returns
+        LZ4-compressed messages associated with Stan fit, one or more LZ4 frames.
+        Fits are written by the process calling the stan::services function
+        (see ``httpstan/fit_file.hpp``).
     """
     # fits are stored under their "parent" models
     path = fit_path(name)
-    path.parent.mkdir(parents=True, exist_ok=True)
-    with path.open("wb") as fh:
-        fh.write(fit_bytes)
+    try:
+        with path.open("rb") as fh:
+            return fh.read()
+    except FileNotFoundError:
+        raise KeyError(f"Fit `{name}` not found.")
 
 
-def load_fit(name: str) -> bytes:
-    """Load Stan fit from the filesystem-based cache.
+def load_fit_summary(name: str) -> bytes:
+    """Load the summary of a Stan fit from the filesystem-based cache.
 
     Arguments:
         name: Stan fit name
-        model_name: Stan model name
 
     Returns
-        LZ4-compressed messages associated with Stan fit.
+        JSON-encoded summary of the draws (see ``httpstan/summary.hpp``).
     """
-    # fits are stored under their "parent" models
-    path = fit_path(name)
     try:
-        with path.open("rb") as fh:
+        with fit_summary_path(name).open("rb") as fh:
             return fh.read()
     except FileNotFoundError:
-        raise KeyError(f"Fit `{name}` not found.")
+        raise KeyError(f"Summary of fit `{name}` not found.")
+
+
+def load_fit_sketch(name: str) -> bytes:
+    """Load the summary of a Stan fit, in the binary wire format, from the filesystem-based cache.
+
+    Arguments:
+        name: Stan fit name
+
+    Returns
+        Summary including the t-digests of the draws (see ``httpstan.summaries``).
+    """
+    try:
+        with fit_sketch_path(name).open("rb") as fh:
+            return fh.read()
+    except FileNotFoundError:
+        raise KeyError(f"Summary of fit `{name}` not found.")
 
 
 def delete_fit(name: str) -> None:
-    """Delete Stan fit from the filesystem-based cache.
+    """Delete Stan fit, and its summaries, from the filesystem-based cache.
 
     Arguments:
         name: Stan fit name
     """
     path = fit_path(name)
     path.unlink()
+    for summary_path in (fit_summary_path(name), fit_sketch_path(name)):
+        try:
+            summary_path.unlink()
+        except FileNotFoundError:
+            pass
@@ -1,3 +1,17 @@
 import os
 
 HTTPSTAN_DEBUG = os.environ.get("HTTPSTAN_DEBUG", "0") in {"true", "1"}
+
+# Capacity, in bytes, of the per-process cache of parsed data (see ``stan_services.data_cache_info``)
+HTTPSTAN_DATA_CACHE_SIZE = int(os.environ.get("HTTPSTAN_DATA_CACHE_SIZE", 256 * 1024 * 1024))
+
+# Number of constructed models kept per model for reuse (see ``stan_services.model_pool_info``)
+HTTPSTAN_MODEL_POOL_SIZE = int(os.environ.get("HTTPSTAN_MODEL_POOL_SIZE", 16))
+
+# Directory holding ``.npy`` and ``.npz`` files which data may refer to by path, e.g. ``{"X": "X.npy"}``.
+# Referring to data files is disabled if unset. Parsed data and constructed models are cached; a file is read
+# again once its inode, size or modification time changes. Files must not be modified while they are read.
+HTTPSTAN_DATA_DIRECTORY = os.environ.get("HTTPSTAN_DATA_DIRECTORY", "")
+
+# Number of threads calling the services extension module (e.g., ``log_prob``) on behalf of requests
+HTTPSTAN_NUM_THREADS = int(os.environ.get("HTTPSTAN_NUM_THREADS", os.cpu_count() or 1))
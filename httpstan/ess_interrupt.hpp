@@ -0,0 +1,126 @@
+#ifndef HTTPSTAN_ESS_INTERRUPT_HPP
+#define HTTPSTAN_ESS_INTERRUPT_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <stan/callbacks/interrupt.hpp>
+#include <string>
+#include <vector>
+
+#include "socket_writer.hpp"
+
+namespace httpstan {
+
+/**
+ * Thrown by <code>ess_interrupt</code> to end sampling. It is not an error:
+ * the draws written so far are the fit.
+ */
+class sampling_stopped : public std::runtime_error {
+public:
+  const double ess;
+
+  /**
+   * @param[in] ess smallest effective sample size of the watched columns
+   */
+  explicit sampling_stopped(double ess)
+      : std::runtime_error("Sampling stopped, the effective sample size reached " + std::to_string(ess) + "."),
+        ess(ess) {}
+};
+
+} // namespace httpstan
+
+namespace stan {
+namespace callbacks {
+
+/**
+ * <code>ess_interrupt</code> ends sampling once the effective sample size
+ * (ESS) of each watched column of the draws reaches a target.
+ *
+ * stan::services functions call the interrupt before each iteration. The
+ * ESS is estimated from the summary kept by the sample writer (see
+ * <code>httpstan::summary::ess</code>), which only changes when a block of
+ * draws is complete, so it is estimated once per block. Sampling is ended by
+ * throwing <code>httpstan::sampling_stopped</code>, which the caller catches.
+ *
+ * Estimates from few draws are unreliable, so the ESS is first estimated once
+ * blocks of single draws have been merged, i.e., from at least half of
+ * `httpstan::summary::max_blocks` blocks of two or more draws. The ESS of
+ * anticorrelated draws exceeds the number of draws, so sampling may still end
+ * with fewer draws than the target.
+ *
+ * Columns are watched if they match a pattern (see
+ * <code>sample_socket_writer::matches</code>) or, without patterns, if they
+ * are not sampler columns, whose names end in ``__``. Watched columns whose
+ * draws are all equal, e.g., constant generated quantities, are taken to
+ * have reached the target. The writer receives the column header before the
+ * first iteration, so the columns are resolved, and patterns which match no
+ * column rejected, before any draw is made.
+ */
+class ess_interrupt : public interrupt {
+private:
+  const sample_socket_writer &writer_;
+  const double target_;
+  const std::vector<std::string> patterns_;
+  // if true, draws are watched once adaptation has terminated
+  const bool after_adaptation_;
+  // indices of the watched columns, set once the column header has been written
+  std::vector<std::size_t> columns_;
+  // draws in the summary when the ESS was last estimated
+  uint64_t num_draws_ = 0;
+
+public:
+  /**
+   * @param[in] writer sample writer, whose summary holds the draws
+   * @param[in] target effective sample size at which sampling ends
+   * @param[in] patterns patterns of the columns to watch. If empty, all columns apart from sampler columns.
+   * @param[in] after_adaptation true if draws before the end of adaptation are warmup draws
+   */
+  ess_interrupt(const sample_socket_writer &writer, double target, const std::vector<std::string> &patterns,
+                bool after_adaptation)
+      : writer_(writer), target_(target), patterns_(patterns), after_adaptation_(after_adaptation) {
+    if (!(target > 0))
+      throw std::invalid_argument("Target effective sample size must be positive.");
+  }
+
+  void operator()() {
+    const httpstan::summary &summary = writer_.summary();
+    if (columns_.empty()) {
+      const std::vector<std::string> &names = summary.names();
+      if (names.empty())
+        throw std::runtime_error("Sample writer should receive the column header before the first iteration.");
+      for (std::size_t i = 0; i < names.size(); ++i) {
+        const bool sampler = names[i].size() >= 2 && names[i].compare(names[i].size() - 2, 2, "__") == 0;
+        if (patterns_.empty() ? !sampler : sample_socket_writer::matches(patterns_, names[i]))
+          columns_.push_back(i);
+      }
+      if (columns_.empty())
+        throw std::invalid_argument("No columns match the parameters whose effective sample size is watched.");
+    }
+
+    if (after_adaptation_ && !writer_.adaptation_terminated())
+      return;
+    if (summary.block_size() < 2 || summary.num_draws() < num_draws_ + summary.block_size())
+      return;
+    num_draws_ = summary.num_draws();
+
+    double ess = std::numeric_limits<double>::infinity();
+    for (std::size_t i : columns_) {
+      // constant columns, which have no ESS, do not hold sampling back
+      if (summary.constant(i))
+        continue;
+      // NaN if there are too few draws
+      const double column_ess = summary.ess(i);
+      if (!(column_ess >= target_))
+        return;
+      ess = std::min(ess, column_ess);
+    }
+    throw httpstan::sampling_stopped(ess);
+  }
+};
+
+} // namespace callbacks
+} // namespace stan
+#endif // HTTPSTAN_ESS_INTERRUPT_HPP
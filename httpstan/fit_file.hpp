@@ -0,0 +1,221 @@
+#ifndef HTTPSTAN_FIT_FILE_HPP
+#define HTTPSTAN_FIT_FILE_HPP
+
+#include <lz4/lz4frame.h>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace httpstan {
+
+/**
+ * Channels of the messages written in a call to a stan::services function, one per callback.
+ */
+enum class channel : uint8_t { logger = 0, sample_writer = 1, diagnostic_writer = 2, init_writer = 3 };
+const std::size_t num_channels = 4;
+
+/**
+ * <code>fit_file</code> writes the messages of a call to a stan::services
+ * function to a fit in the httpstan cache (see ``httpstan.cache.fit_path``).
+ *
+ * A fit holds one LZ4 frame (see the LZ4 frame format) for each channel, in
+ * the order in which the channels write their first message. Messages are
+ * compressed as they are written, into an unnamed temporary file for each
+ * channel in the directory of the fit. LZ4 collects input in blocks of 64 KiB,
+ * so memory use does not grow with the size of the fit. <code>commit</code>
+ * ends the frames and copies them into a new file which is then renamed, so a
+ * fit appears in the cache complete or not at all.
+ *
+ * Small files stored alongside the fit ("sidecars", e.g., a summary of the
+ * draws) are committed before the fit, so they are in place once it appears.
+ */
+class fit_file {
+private:
+  std::string path_;
+  std::array<LZ4F_cctx *, num_channels> compressors_{};
+  std::array<std::FILE *, num_channels> files_{};
+  // channels in the order of their first message
+  std::vector<std::size_t> order_;
+  // suffixes and contents of sidecars
+  std::vector<std::pair<std::string, std::string>> sidecars_;
+  LZ4F_preferences_t preferences_{};
+  std::vector<char> buffer_;
+  bool committed_ = false;
+
+  static std::size_t check_lz4(std::size_t code) {
+    if (LZ4F_isError(code))
+      throw std::runtime_error(std::string("LZ4 compression failed: ") + LZ4F_getErrorName(code));
+    return code;
+  }
+
+  void check(bool ok, const char *what) const {
+    if (!ok)
+      throw std::runtime_error("Unable to write fit `" + path_ + "` (" + what + "): " + std::strerror(errno));
+  }
+
+  /**
+   * Create a file next to the fit, storing its name in `name`.
+   */
+  std::FILE *create_file(std::string &name) const {
+    name = path_ + ".XXXXXX";
+    int fd = mkstemp(&name[0]);
+    check(fd != -1, "mkstemp");
+    std::FILE *file = fdopen(fd, "w+b");
+    if (!file) {
+      int error = errno;
+      close(fd);
+      unlink(name.c_str());
+      errno = error;
+      check(false, "fdopen");
+    }
+    return file;
+  }
+
+  /**
+   * Write a file next to the fit and rename it to `path`.
+   */
+  void write_file(const std::string &path, const std::string &contents) const {
+    std::string name;
+    std::FILE *file = create_file(name);
+    try {
+      check(fchmod(fileno(file), 0644) == 0, "fchmod");
+      check(std::fwrite(contents.data(), 1, contents.size(), file) == contents.size(), "fwrite");
+      std::FILE *closing = file;
+      file = nullptr;
+      check(std::fclose(closing) == 0, "fclose");
+      check(std::rename(name.c_str(), path.c_str()) == 0, "rename");
+    } catch (...) {
+      if (file)
+        std::fclose(file);
+      unlink(name.c_str());
+      throw;
+    }
+  }
+
+  /**
+   * Write the first `size` bytes of the buffer to the file of a channel.
+   */
+  void output(std::size_t channel_index, std::size_t size) {
+    if (size > 0)
+      check(std::fwrite(buffer_.data(), 1, size, files_[channel_index]) == size, "fwrite");
+  }
+
+  /**
+   * Create the file of a channel and start its LZ4 frame.
+   */
+  void start(std::size_t channel_index) {
+    check_lz4(LZ4F_createCompressionContext(&compressors_[channel_index], LZ4F_VERSION));
+    std::string name;
+    files_[channel_index] = create_file(name);
+    // the file is only read through `files_`, remove its name at once
+    unlink(name.c_str());
+    order_.push_back(channel_index);
+    buffer_.resize(LZ4F_HEADER_SIZE_MAX);
+    output(channel_index,
+           check_lz4(LZ4F_compressBegin(compressors_[channel_index], buffer_.data(), buffer_.size(), &preferences_)));
+  }
+
+  void release() noexcept {
+    for (std::size_t i = 0; i < num_channels; ++i) {
+      if (compressors_[i])
+        LZ4F_freeCompressionContext(compressors_[i]);
+      if (files_[i])
+        std::fclose(files_[i]);
+      compressors_[i] = nullptr;
+      files_[i] = nullptr;
+    }
+    order_.clear();
+  }
+
+public:
+  /**
+   * @param[in] path path of the fit. Its directory must exist.
+   */
+  explicit fit_file(const std::string &path) : path_(path) {}
+
+  fit_file(const fit_file &) = delete;
+  fit_file &operator=(const fit_file &) = delete;
+
+  /**
+   * Discards the fit unless it has been committed.
+   */
+  ~fit_file() { release(); }
+
+  /**
+   * Add `size` bytes to the LZ4 frame of a channel.
+   *
+   * @param[in] channel_id channel of the message
+   * @param[in] data pointer to the message
+   * @param[in] size size of the message in bytes
+   */
+  void write(channel channel_id, const char *data, std::size_t size) {
+    std::size_t i = static_cast<std::size_t>(channel_id);
+    if (!compressors_[i])
+      start(i);
+    buffer_.resize(LZ4F_compressBound(size, &preferences_));
+    output(i, check_lz4(LZ4F_compressUpdate(compressors_[i], buffer_.data(), buffer_.size(), data, size, nullptr)));
+  }
+
+  /**
+   * Store a file alongside the fit when it is committed.
+   *
+   * @param[in] suffix suffix added to the path of the fit to give the path of the file
+   * @param[in] contents contents of the file
+   */
+  void add_sidecar(const std::string &suffix, std::string contents) {
+    sidecars_.emplace_back(suffix, std::move(contents));
+  }
+
+  /**
+   * Write the sidecars, end the LZ4 frames and move the fit into place. No
+   * messages may be written afterwards. Later calls do nothing, even if the
+   * first failed.
+   */
+  void commit() {
+    if (committed_)
+      return;
+    committed_ = true;
+    for (const auto &sidecar : sidecars_)
+      write_file(path_ + sidecar.first, sidecar.second);
+    std::string name;
+    std::FILE *fit = create_file(name);
+    try {
+      // mkstemp creates files readable only by their owner, use the permissions of other files in the cache
+      check(fchmod(fileno(fit), 0644) == 0, "fchmod");
+      std::vector<char> chunk(64 * 1024);
+      for (std::size_t i : order_) {
+        buffer_.resize(LZ4F_compressBound(0, &preferences_));
+        output(i, check_lz4(LZ4F_compressEnd(compressors_[i], buffer_.data(), buffer_.size(), nullptr)));
+        check(std::fflush(files_[i]) == 0 && std::fseek(files_[i], 0, SEEK_SET) == 0, "fseek");
+        std::size_t size;
+        while ((size = std::fread(chunk.data(), 1, chunk.size(), files_[i])) > 0)
+          check(std::fwrite(chunk.data(), 1, size, fit) == size, "fwrite");
+        check(!std::ferror(files_[i]), "fread");
+      }
+      std::FILE *closing = fit;
+      fit = nullptr;
+      check(std::fclose(closing) == 0, "fclose");
+      check(std::rename(name.c_str(), path_.c_str()) == 0, "rename");
+    } catch (...) {
+      if (fit)
+        std::fclose(fit);
+      unlink(name.c_str());
+      throw;
+    }
+    release();
+  }
+};
+
+} // namespace httpstan
+#endif // HTTPSTAN_FIT_FILE_HPP
@@ -5,6 +5,8 @@ import pickle
 import random
 import sys
 
+import lz4.frame
+
 import httpstan
 
 
@@ -21,7 +23,9 @@ def calculate_fit_name(function: str, model_name: str, kwargs: dict) -> str:
 
     - UTF-8 encoded name of service function (e.g., ``hmc_nuts_diag_e_adapt``)
     - UTF-8 encoded Stan model name (which is derived from a hash of ``program_code``)
-    - Bytes of pickled kwargs dictionary
+    - Bytes of pickled kwargs dictionary. Callers replace ``data`` and ``init``
+      with hashes of their values (``canonical_data_digest`` in the services
+      extension module), so the name does not depend on how data is encoded.
     - UTF-8 encoded string recording the httpstan version
     - UTF-8 encoded string identifying the system platform
     - UTF-8 encoded string identifying the system bit architecture
@@ -61,3 +65,27 @@ def calculate_fit_name(function: str, model_name: str, kwargs: dict) -> str:
 
     id = base64.b32encode(hash.digest()).decode().lower()
     return f"{model_name}/fits/{id}"
+
+
+def decompress(fit_bytes_lz4: bytes) -> bytes:
+    """Decompress the messages of a fit.
+
+    A fit holds one LZ4 frame for each writer and one for the logger,
+    written by the process calling the services function (see
+    ``httpstan/fit_file.hpp``). The frames are decompressed in order and the
+    messages concatenated.
+
+    Arguments:
+        fit_bytes_lz4: concatenated LZ4 frames
+
+    Returns:
+        bytes: messages
+    """
+    chunks = []
+    while fit_bytes_lz4:
+        decompressor = lz4.frame.LZ4FrameDecompressor()
+        chunks.append(decompressor.decompress(fit_bytes_lz4))
+        if not decompressor.eof:
+            raise ValueError("Fit ends in the middle of an LZ4 frame.")
+        fit_bytes_lz4 = decompressor.unused_data
+    return b"".join(chunks)
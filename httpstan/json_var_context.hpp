@@ -0,0 +1,379 @@
+#ifndef HTTPSTAN_JSON_VAR_CONTEXT_HPP
+#define HTTPSTAN_JSON_VAR_CONTEXT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <rapidjson/error/en.h>
+#include <rapidjson/memorystream.h>
+#include <rapidjson/reader.h>
+
+#include "array_var_context_builder.hpp"
+#include "npy_data.hpp"
+
+/**
+ * Parse JSON-encoded data for a Stan model without creating Python objects.
+ *
+ * Data is a JSON object mapping variable names to numbers or (nested) arrays
+ * of numbers. For example:
+ *   {"N": 3, "y": [0, 1, 0], "X": [[1.0, 2.0], [3.0, 4.0], [5.0, 6.0]]}
+ *
+ * Types follow NumPy: a variable is integer-valued only if every value is an
+ * integer. Nested arrays are in row-major order and must be rectangular.
+ *
+ * If a directory of data files is given, a variable may instead be a string
+ * referring to a NumPy file in the directory (see `add_npy_data`). For example:
+ *   {"N": 3, "X": "X.npy", "y": "arrays.npz:outcome"}
+ */
+
+namespace httpstan {
+
+/**
+ * rapidjson SAX handler which adds each variable in a JSON-encoded data
+ * object to an <code>array_var_context_builder</code>.
+ */
+class var_context_handler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, var_context_handler> {
+private:
+  array_var_context_builder &builder_;
+  const std::string directory_;
+  std::string error_;
+
+  // 0 outside the data object, 1 inside the data object, 1 + n inside n arrays
+  size_t depth_ = 0;
+  std::string name_;
+  // names of the variables so far
+  std::set<std::string> names_;
+  std::vector<double> values_;
+  bool real_ = false;
+  // dims_[i] is the length of arrays at nesting level i, or -1 if no array at that level has ended
+  std::vector<long> dims_;
+  std::vector<size_t> counts_;
+  // nesting level of the first number in the variable, or -1 if there are no numbers yet
+  long value_level_ = -1;
+
+  bool fail(const std::string &message) {
+    error_ = message;
+    return false;
+  }
+
+  bool invalid_value() { return fail("Values associated with `" + name_ + "` must be (nested) sequences of numbers."); }
+
+  bool add_number(double value, bool real) {
+    if (depth_ == 0)
+      return fail("Data must be a JSON object.");
+    long level = static_cast<long>(depth_) - 1;
+    if (value_level_ == -1)
+      value_level_ = level;
+    else if (value_level_ != level)
+      return fail("Values associated with `" + name_ + "` must be a rectangular (nested) sequence of numbers.");
+    if (level > 0)
+      ++counts_.back();
+    values_.push_back(value);
+    real_ = real_ || real;
+    if (depth_ == 1)
+      end_variable();
+    return true;
+  }
+
+  void end_variable() {
+    std::vector<size_t> dims(dims_.begin(), dims_.end());
+    // empty arrays are real-valued, as in NumPy
+    if (real_ || values_.empty())
+      builder_.add_real(name_, values_.data(), dims, false);
+    else
+      builder_.add_int(name_, values_.data(), dims, false);
+  }
+
+public:
+  explicit var_context_handler(array_var_context_builder &builder, const std::string &directory = "")
+      : builder_(builder), directory_(directory) {}
+
+  /**
+   * Message describing why parsing stopped, empty if the JSON itself was invalid.
+   */
+  const std::string &error() const { return error_; }
+
+  bool Null() { return invalid_value(); }
+  bool Bool(bool) { return invalid_value(); }
+  bool Int(int i) { return add_number(i, false); }
+  bool Uint(unsigned u) { return add_number(u, false); }
+  bool Int64(int64_t i) { return add_number(static_cast<double>(i), false); }
+  bool Uint64(uint64_t u) { return add_number(static_cast<double>(u), false); }
+  bool Double(double d) { return add_number(d, true); }
+  bool String(const char *str, rapidjson::SizeType length, bool) {
+    if (depth_ == 0)
+      return fail("Data must be a JSON object.");
+    if (depth_ > 1)
+      return invalid_value();
+    try {
+      add_npy_data(builder_, name_, std::string(str, length), directory_);
+    } catch (const std::exception &e) {
+      return fail(e.what());
+    }
+    return true;
+  }
+
+  bool StartObject() {
+    if (depth_ != 0)
+      return invalid_value();
+    depth_ = 1;
+    return true;
+  }
+
+  bool Key(const char *str, rapidjson::SizeType length, bool) {
+    name_.assign(str, length);
+    if (!names_.insert(name_).second)
+      return fail("Data has more than one value for `" + name_ + "`.");
+    values_.clear();
+    real_ = false;
+    dims_.clear();
+    counts_.clear();
+    value_level_ = -1;
+    return true;
+  }
+
+  bool EndObject(rapidjson::SizeType) {
+    depth_ = 0;
+    return true;
+  }
+
+  bool StartArray() {
+    if (depth_ == 0)
+      return fail("Data must be a JSON object.");
+    if (!counts_.empty())
+      ++counts_.back();
+    counts_.push_back(0);
+    if (dims_.size() < counts_.size())
+      dims_.push_back(-1);
+    ++depth_;
+    return true;
+  }
+
+  bool EndArray(rapidjson::SizeType) {
+    size_t level = counts_.size() - 1;
+    long count = static_cast<long>(counts_.back());
+    counts_.pop_back();
+    if (dims_[level] == -1)
+      dims_[level] = count;
+    else if (dims_[level] != count)
+      return fail("Values associated with `" + name_ + "` must be a rectangular (nested) sequence of numbers.");
+    --depth_;
+    if (depth_ == 1) {
+      if (value_level_ != -1 && static_cast<size_t>(value_level_) != dims_.size())
+        return fail("Values associated with `" + name_ + "` must be a rectangular (nested) sequence of numbers.");
+      end_variable();
+    }
+    return true;
+  }
+};
+
+/**
+ * Add the variables in JSON-encoded data to `builder`.
+ *
+ * @param[in] json pointer to JSON-encoded data, need not be null-terminated
+ * @param[in] length length of `json` in bytes
+ * @param[in,out] builder builder to which variables are added
+ * @param[in] directory directory holding data files, empty if data files are not enabled
+ * @throw std::invalid_argument if `json` is not valid JSON-encoded data
+ */
+inline void add_json_data(const char *json, size_t length, array_var_context_builder &builder,
+                          const std::string &directory = "") {
+  var_context_handler handler(builder, directory);
+  rapidjson::MemoryStream stream(json, length);
+  rapidjson::Reader reader;
+  rapidjson::ParseResult result = reader.Parse<rapidjson::kParseNanAndInfFlag>(stream, handler);
+  if (!result) {
+    if (!handler.error().empty())
+      throw std::invalid_argument(handler.error());
+    throw std::invalid_argument(std::string("Invalid JSON-encoded data: ") + rapidjson::GetParseError_En(result.Code()));
+  }
+}
+
+/**
+ * rapidjson SAX handler which collects the strings which are values of
+ * top-level members of a data object, i.e., references to data files. It
+ * does not validate the data.
+ */
+class data_file_handler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, data_file_handler> {
+private:
+  size_t depth_ = 0;
+  std::vector<std::string> references_;
+
+public:
+  const std::vector<std::string> &references() const { return references_; }
+
+  bool Default() { return true; }
+  bool RawNumber(const char *, rapidjson::SizeType, bool) { return true; }
+  bool Key(const char *, rapidjson::SizeType, bool) { return true; }
+  bool String(const char *str, rapidjson::SizeType length, bool) {
+    if (depth_ == 1)
+      references_.emplace_back(str, length);
+    return true;
+  }
+  bool StartObject() {
+    ++depth_;
+    return true;
+  }
+  bool EndObject(rapidjson::SizeType) {
+    --depth_;
+    return true;
+  }
+  bool StartArray() {
+    ++depth_;
+    return true;
+  }
+  bool EndArray(rapidjson::SizeType) {
+    --depth_;
+    return true;
+  }
+};
+
+/**
+ * Returns the references to data files in JSON-encoded data (see
+ * `add_npy_data`). Numbers are skipped without being converted.
+ *
+ * @param[in] json pointer to JSON-encoded data, need not be null-terminated
+ * @param[in] length length of `json` in bytes
+ */
+inline std::vector<std::string> data_file_references(const char *json, size_t length) {
+  data_file_handler handler;
+  rapidjson::MemoryStream stream(json, length);
+  rapidjson::Reader reader;
+  // invalid data is reported when it is parsed
+  reader.Parse<rapidjson::kParseNanAndInfFlag | rapidjson::kParseNumbersAsStringsFlag>(stream, handler);
+  return handler.references();
+}
+
+/**
+ * Location of a top-level member of a JSON object.
+ *
+ * The value occupies bytes [begin, end) of the document.
+ */
+struct json_member {
+  std::string name;
+  size_t begin;
+  size_t end;
+};
+
+/**
+ * rapidjson SAX handler which finds top-level members of a JSON request body
+ * holding data objects, e.g., the `data` member of a request to `log_prob`.
+ *
+ * Only values which are objects are located. Their contents are validated in
+ * the same way as by `httpstan.schemas.Data`: values are (nested) arrays of
+ * numbers or strings referring to data files.
+ */
+class data_member_handler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, data_member_handler> {
+private:
+  const std::vector<std::string> &keys_;
+  const rapidjson::MemoryStream &stream_;
+  std::vector<json_member> members_;
+  std::string error_;
+
+  size_t depth_ = 0;
+  // true between a top-level key in `keys_` and the end of its value
+  bool in_data_member_ = false;
+  std::string name_;
+
+  bool fail(const std::string &message) {
+    error_ = message;
+    return false;
+  }
+
+  bool value(bool number) {
+    if (in_data_member_ && depth_ > 1 && !number)
+      return fail("Values associated with `" + name_ + "` must be (nested) sequences of numbers.");
+    if (depth_ == 1)
+      in_data_member_ = false;
+    return true;
+  }
+
+public:
+  data_member_handler(const std::vector<std::string> &keys, const rapidjson::MemoryStream &stream)
+      : keys_(keys), stream_(stream) {}
+
+  const std::vector<json_member> &members() const { return members_; }
+  const std::string &error() const { return error_; }
+
+  bool Null() { return value(false); }
+  bool Bool(bool) { return value(false); }
+  bool Int(int) { return value(true); }
+  bool Uint(unsigned) { return value(true); }
+  bool Int64(int64_t) { return value(true); }
+  bool Uint64(uint64_t) { return value(true); }
+  bool Double(double) { return value(true); }
+  bool String(const char *, rapidjson::SizeType, bool) { return value(in_data_member_ && depth_ == 2); }
+
+  bool StartObject() {
+    if (in_data_member_ && depth_ == 1) {
+      // the reader has consumed the opening brace
+      members_.push_back({name_, stream_.Tell() - 1, 0});
+    } else if (in_data_member_ && depth_ > 1) {
+      return fail("Values associated with `" + name_ + "` must be (nested) sequences of numbers.");
+    }
+    ++depth_;
+    return true;
+  }
+
+  bool Key(const char *str, rapidjson::SizeType length, bool) {
+    if (depth_ == 1) {
+      name_.assign(str, length);
+      in_data_member_ = false;
+      for (const std::string &key : keys_)
+        in_data_member_ = in_data_member_ || key == name_;
+    } else if (in_data_member_ && depth_ == 2) {
+      name_.assign(str, length);
+    }
+    return true;
+  }
+
+  bool EndObject(rapidjson::SizeType) {
+    --depth_;
+    if (in_data_member_ && depth_ == 1) {
+      members_.back().end = stream_.Tell();
+      in_data_member_ = false;
+    }
+    return true;
+  }
+
+  bool StartArray() {
+    ++depth_;
+    return true;
+  }
+
+  bool EndArray(rapidjson::SizeType) {
+    --depth_;
+    if (depth_ == 1)
+      in_data_member_ = false;
+    return true;
+  }
+};
+
+/**
+ * Returns the locations of top-level members named in `keys` whose values are objects.
+ *
+ * @param[in] json pointer to a JSON-encoded object, need not be null-terminated
+ * @param[in] length length of `json` in bytes
+ * @param[in] keys names of members holding data
+ * @throw std::invalid_argument if `json` is not valid JSON or data values are not numbers
+ */
+inline std::vector<json_member> find_data_members(const char *json, size_t length,
+                                                  const std::vector<std::string> &keys) {
+  rapidjson::MemoryStream stream(json, length);
+  data_member_handler handler(keys, stream);
+  rapidjson::Reader reader;
+  rapidjson::ParseResult result = reader.Parse<rapidjson::kParseNanAndInfFlag>(stream, handler);
+  if (!result) {
+    if (!handler.error().empty())
+      throw std::invalid_argument(handler.error());
+    throw std::invalid_argument(std::string("Invalid JSON: ") + rapidjson::GetParseError_En(result.Code()));
+  }
+  return handler.members();
+}
+
+} // namespace httpstan
+#endif // HTTPSTAN_JSON_VAR_CONTEXT_HPP
@@ -0,0 +1,131 @@
+#ifndef HTTPSTAN_LRU_CACHE_HPP
+#define HTTPSTAN_LRU_CACHE_HPP
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace httpstan {
+
+/**
+ * Bounded least-recently-used cache of shared objects.
+ *
+ * Each object has a size, in units chosen by the user (e.g., bytes, or 1 to
+ * count objects). The combined size of cached objects never exceeds the
+ * capacity. Objects are shared: an object evicted while in use is deleted once
+ * no longer used.
+ *
+ * All methods are thread-safe.
+ */
+template <typename T>
+class lru_cache {
+public:
+  typedef std::shared_ptr<T> value_type;
+
+  explicit lru_cache(size_t capacity) : capacity_(capacity) {}
+
+  /**
+   * Returns the object stored under `key`, or an empty pointer if there is none.
+   */
+  value_type get(const std::string &key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+      ++misses_;
+      return value_type();
+    }
+    ++hits_;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->value;
+  }
+
+  /**
+   * Store `value` under `key`, evicting least recently used objects as needed.
+   *
+   * An object larger than the capacity is not stored. If an object is already
+   * stored under `key`, it is kept.
+   *
+   * @param[in] key key identifying `value`
+   * @param[in] value object to store
+   * @param[in] size size of `value`
+   */
+  void put(const std::string &key, value_type value, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (index_.count(key) || size > capacity_)
+      return;
+    entries_.push_front({key, std::move(value), size});
+    index_[key] = entries_.begin();
+    size_ += size;
+    evict();
+  }
+
+  void clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    index_.clear();
+    size_ = 0;
+  }
+
+  void set_capacity(size_t capacity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_ = capacity;
+    evict();
+  }
+
+  size_t capacity() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return capacity_;
+  }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return size_;
+  }
+
+  size_t entries() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+  }
+
+  size_t hits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+  }
+
+  size_t misses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+  }
+
+private:
+  struct entry {
+    std::string key;
+    value_type value;
+    size_t size;
+  };
+
+  // most recently used first
+  std::list<entry> entries_;
+  std::unordered_map<std::string, typename std::list<entry>::iterator> index_;
+  size_t capacity_;
+  size_t size_ = 0;
+  size_t hits_ = 0;
+  size_t misses_ = 0;
+  mutable std::mutex mutex_;
+
+  // requires mutex_ to be held
+  void evict() {
+    while (size_ > capacity_) {
+      size_ -= entries_.back().size;
+      index_.erase(entries_.back().key);
+      entries_.pop_back();
+    }
+  }
+};
+
+} // namespace httpstan
+#endif // HTTPSTAN_LRU_CACHE_HPP
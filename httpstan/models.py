@@ -132,6 +132,7 @@ async def build_services_extension_module(program_code: str, extra_compile_args:
         ("BOOST_DISABLE_ASSERTS", None),
         ("BOOST_PHOENIX_NO_VARIADIC_EXPRESSION", None),
         ("STAN_THREADS", None),
+        ("STAN_MODEL_FVAR_VAR", None),  # required by `hessian` and `hessian_vector_product`
         ("_REENTRANT", None),  # required by stan math / std:lgamma
         # the following is needed on linux for compatibility with libraries built with the manylinux2014 image
         ("_GLIBCXX_USE_CXX11_ABI", "0"),
@@ -143,7 +144,7 @@ async def build_services_extension_module(program_code: str, extra_compile_args:
     # Note: `library_dirs` is only relevant for linking. It does not tell an extension
     # where to find shared libraries during execution. There are two ways for an
     # extension module to find shared libraries: LD_LIBRARY_PATH and rpath.
-    libraries = ["sundials_cvodes", "sundials_idas", "sundials_nvecserial", "tbb"]
+    libraries = ["sundials_cvodes", "sundials_idas", "sundials_nvecserial", "tbb", "lz4"]
     if platform.system() == "Darwin":  # pragma: no cover
         libraries.extend(["tbbmalloc", "tbbmalloc_proxy"])
     extension = setuptools.Extension(
@@ -0,0 +1,320 @@
+#ifndef HTTPSTAN_NPY_DATA_HPP
+#define HTTPSTAN_NPY_DATA_HPP
+
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "array_var_context_builder.hpp"
+
+/**
+ * Read data for a Stan model from NumPy `.npy` and `.npz` files.
+ *
+ * Files are memory-mapped and values are copied directly from the mapped
+ * pages. Members of `.npz` files must be stored without compression, as
+ * `numpy.savez` does.
+ */
+
+namespace httpstan {
+
+/**
+ * Read-only memory map of a file.
+ */
+class mapped_file {
+private:
+  void *data_ = nullptr;
+  size_t size_ = 0;
+
+public:
+  explicit mapped_file(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+      throw std::invalid_argument("Unable to open data file `" + path + "`: " + std::strerror(errno) + ".");
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+      close(fd);
+      throw std::invalid_argument("Unable to read data file `" + path + "`: " + std::strerror(errno) + ".");
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ > 0) {
+      data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data_ == MAP_FAILED) {
+        data_ = nullptr;
+        close(fd);
+        throw std::invalid_argument("Unable to map data file `" + path + "`: " + std::strerror(errno) + ".");
+      }
+    }
+    close(fd);
+  }
+
+  mapped_file(const mapped_file &) = delete;
+  mapped_file &operator=(const mapped_file &) = delete;
+
+  ~mapped_file() {
+    if (data_)
+      munmap(data_, size_);
+  }
+
+  const char *data() const { return static_cast<const char *>(data_); }
+  size_t size() const { return size_; }
+};
+
+namespace internal {
+
+// read a little-endian unsigned integer of `N` bytes
+template <size_t N>
+inline uint64_t read_le(const char *p) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < N; ++i)
+    value |= static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+  return value;
+}
+
+// Returns the value of `key` in the header of a .npy file, e.g. `'<f8'` for `descr`.
+inline std::string npy_header_value(const std::string &header, const std::string &key, const std::string &path) {
+  size_t position = header.find("'" + key + "'");
+  if (position == std::string::npos)
+    throw std::invalid_argument("Data file `" + path + "` has no `" + key + "` in its header.");
+  position = header.find(':', position);
+  size_t begin = position == std::string::npos ? position : header.find_first_not_of(' ', position + 1);
+  if (begin == std::string::npos)
+    throw std::invalid_argument("Data file `" + path + "` has an invalid header.");
+  size_t end = header[begin] == '(' ? header.find(')', begin) : header.find_first_of(",}", begin);
+  if (end == std::string::npos)
+    throw std::invalid_argument("Data file `" + path + "` has an invalid header.");
+  return header.substr(begin, end - begin + (header[begin] == '(' ? 1 : 0));
+}
+
+template <typename S>
+void add_npy_values(array_var_context_builder &builder, const std::string &name, bool is_int, const char *data,
+                    const std::vector<size_t> &dims, bool column_major) {
+  size_t size = 1;
+  for (size_t dim : dims)
+    size *= dim;
+  const S *values = reinterpret_cast<const S *>(data);
+  // members of .npz files need not be aligned
+  std::vector<S> aligned;
+  if (reinterpret_cast<uintptr_t>(data) % alignof(S) != 0) {
+    aligned.resize(size);
+    std::memcpy(aligned.data(), data, size * sizeof(S));
+    values = aligned.data();
+  }
+  if (is_int)
+    builder.add_int(name, values, dims, column_major);
+  else
+    builder.add_real(name, values, dims, column_major);
+}
+
+/**
+ * Add the array in a .npy file held in `buffer` to `builder`.
+ */
+inline void add_npy(array_var_context_builder &builder, const std::string &name, const char *buffer, size_t size,
+                    const std::string &path) {
+  static const char magic[] = "\x93NUMPY";
+  if (size < 10 || std::memcmp(buffer, magic, 6) != 0)
+    throw std::invalid_argument("Data file `" + path + "` is not a .npy file.");
+  unsigned major = static_cast<unsigned char>(buffer[6]);
+  size_t header_length, header_offset;
+  if (major == 1) {
+    header_length = read_le<2>(buffer + 8);
+    header_offset = 10;
+  } else if (size >= 12 && (major == 2 || major == 3)) {
+    header_length = read_le<4>(buffer + 8);
+    header_offset = 12;
+  } else {
+    throw std::invalid_argument("Data file `" + path + "` has an unsupported .npy format version.");
+  }
+  if (size < header_offset + header_length)
+    throw std::invalid_argument("Data file `" + path + "` is truncated.");
+  std::string header(buffer + header_offset, header_length);
+
+  std::string descr = npy_header_value(header, "descr", path);
+  bool column_major = npy_header_value(header, "fortran_order", path) == "True";
+  std::string shape = npy_header_value(header, "shape", path);
+  std::vector<size_t> dims;
+  size_t num_values = 1;
+  for (const char *p = shape.c_str(); *p;) {
+    if (*p >= '0' && *p <= '9') {
+      char *end;
+      dims.push_back(std::strtoull(p, &end, 10));
+      num_values *= dims.back();
+      p = end;
+    } else {
+      ++p;
+    }
+  }
+
+  const char *data = buffer + header_offset + header_length;
+  size_t item_size;
+  if (descr == "'<f8'" || descr == "'<i8'")
+    item_size = 8;
+  else if (descr == "'<f4'" || descr == "'<i4'")
+    item_size = 4;
+  else
+    throw std::invalid_argument("Data file `" + path + "` holds values of unsupported type " + descr
+                                + ". Supported types are float64, float32, int64 and int32.");
+  if (size - header_offset - header_length < num_values * item_size)
+    throw std::invalid_argument("Data file `" + path + "` is truncated.");
+
+  if (descr == "'<f8'")
+    add_npy_values<double>(builder, name, false, data, dims, column_major);
+  else if (descr == "'<f4'")
+    add_npy_values<float>(builder, name, false, data, dims, column_major);
+  else if (descr == "'<i8'")
+    add_npy_values<int64_t>(builder, name, true, data, dims, column_major);
+  else
+    add_npy_values<int32_t>(builder, name, true, data, dims, column_major);
+}
+
+/**
+ * Find the member `member` of a .npz (zip) file held in `buffer`.
+ *
+ * @param[out] member_size size of the member in bytes
+ * @return pointer to the start of the member
+ */
+inline const char *find_npz_member(const char *buffer, size_t size, const std::string &member,
+                                   const std::string &path, size_t &member_size) {
+  // end of central directory record, followed by a comment of at most 65535 bytes
+  const size_t eocd_size = 22;
+  if (size < eocd_size)
+    throw std::invalid_argument("Data file `" + path + "` is not a .npz file.");
+  size_t eocd = size - eocd_size;
+  while (read_le<4>(buffer + eocd) != 0x06054b50) {
+    if (eocd == 0 || size - eocd > eocd_size + 65535)
+      throw std::invalid_argument("Data file `" + path + "` is not a .npz file.");
+    --eocd;
+  }
+  size_t num_entries = read_le<2>(buffer + eocd + 10);
+  size_t entry = read_le<4>(buffer + eocd + 16);
+  for (size_t i = 0; i < num_entries; ++i) {
+    if (entry + 46 > size || read_le<4>(buffer + entry) != 0x02014b50)
+      throw std::invalid_argument("Data file `" + path + "` is not a valid .npz file.");
+    size_t method = read_le<2>(buffer + entry + 10);
+    size_t compressed_size = read_le<4>(buffer + entry + 20);
+    size_t name_length = read_le<2>(buffer + entry + 28);
+    size_t extra_length = read_le<2>(buffer + entry + 30);
+    size_t comment_length = read_le<2>(buffer + entry + 32);
+    size_t local_header = read_le<4>(buffer + entry + 42);
+    if (entry + 46 + name_length > size)
+      throw std::invalid_argument("Data file `" + path + "` is not a valid .npz file.");
+    if (std::string(buffer + entry + 46, name_length) == member) {
+      if (method != 0)
+        throw std::invalid_argument("Member `" + member + "` of data file `" + path
+                                    + "` is compressed. Use `numpy.savez` rather than `numpy.savez_compressed`.");
+      if (compressed_size == 0xffffffff || local_header == 0xffffffff)
+        throw std::invalid_argument("Data file `" + path + "` is too large. ZIP64 .npz files are not supported.");
+      if (local_header + 30 > size || read_le<4>(buffer + local_header) != 0x04034b50)
+        throw std::invalid_argument("Data file `" + path + "` is not a valid .npz file.");
+      size_t offset = local_header + 30 + read_le<2>(buffer + local_header + 26)
+                      + read_le<2>(buffer + local_header + 28);
+      if (offset + compressed_size > size)
+        throw std::invalid_argument("Data file `" + path + "` is truncated.");
+      member_size = compressed_size;
+      return buffer + offset;
+    }
+    entry += 46 + name_length + extra_length + comment_length;
+  }
+  throw std::invalid_argument("Data file `" + path + "` has no member `" + member + "`.");
+}
+
+/**
+ * Returns the path of the file `reference` refers to, without the member of a `.npz` file.
+ */
+inline std::string reference_path(const std::string &reference) {
+  size_t separator = reference.rfind(':');
+  if (separator != std::string::npos && separator >= 4 && reference.compare(separator - 4, 4, ".npz") == 0)
+    return reference.substr(0, separator);
+  return reference;
+}
+
+} // namespace internal
+
+/**
+ * Returns the canonical path of `reference`, a path relative to `directory`.
+ *
+ * @throw std::invalid_argument if the file does not exist or is outside `directory`
+ */
+inline std::string resolve_data_path(const std::string &directory, const std::string &reference) {
+  if (directory.empty())
+    throw std::invalid_argument("Data files are not enabled. Set HTTPSTAN_DATA_DIRECTORY to a directory holding "
+                                ".npy and .npz files to refer to them in data.");
+  char resolved_directory[PATH_MAX];
+  char resolved[PATH_MAX];
+  if (!realpath(directory.c_str(), resolved_directory))
+    throw std::invalid_argument("Data directory `" + directory + "` does not exist.");
+  if (reference.empty() || reference[0] == '/' || !realpath((directory + "/" + reference).c_str(), resolved))
+    throw std::invalid_argument("Data file `" + reference + "` not found.");
+  std::string prefix = std::string(resolved_directory) + "/";
+  if (std::string(resolved).compare(0, prefix.size(), prefix) != 0)
+    throw std::invalid_argument("Data file `" + reference + "` not found.");
+  return resolved;
+}
+
+/**
+ * Returns a string which changes when the file `reference` (as in
+ * `add_npy_data`) refers to changes: its device, inode, size and modification
+ * time. The file is not read. If the file cannot be found, returns
+ * `reference`, as reading the data fails anyway.
+ *
+ * @param[in] directory directory holding data files, empty if data files are not enabled
+ * @param[in] reference reference to a file holding a variable
+ */
+inline std::string data_file_version(const std::string &directory, const std::string &reference) {
+  struct stat status;
+  try {
+    if (stat(resolve_data_path(directory, internal::reference_path(reference)).c_str(), &status) != 0)
+      return reference;
+  } catch (const std::invalid_argument &) {
+    return reference;
+  }
+#ifdef __APPLE__
+  const struct timespec &modified = status.st_mtimespec;
+#else
+  const struct timespec &modified = status.st_mtim;
+#endif
+  return std::to_string(status.st_dev) + ":" + std::to_string(status.st_ino) + ":" + std::to_string(status.st_size)
+         + ":" + std::to_string(modified.tv_sec) + "." + std::to_string(modified.tv_nsec);
+}
+
+/**
+ * Add a variable stored in a NumPy file to `builder`.
+ *
+ * `reference` is a path relative to `directory`, which is one of
+ *   - `file.npy`
+ *   - `file.npz`, referring to the member named after the variable
+ *   - `file.npz:member`, referring to the member `member`
+ *
+ * @param[in,out] builder builder to which the variable is added
+ * @param[in] name variable name
+ * @param[in] reference reference to the file holding the variable
+ * @param[in] directory directory holding data files, empty if data files are not enabled
+ * @throw std::invalid_argument if the file cannot be read
+ */
+inline void add_npy_data(array_var_context_builder &builder, const std::string &name, const std::string &reference,
+                         const std::string &directory) {
+  std::string reference_path = internal::reference_path(reference);
+  std::string member = reference_path.size() < reference.size() ? reference.substr(reference_path.size() + 1) : name;
+  mapped_file file(resolve_data_path(directory, reference_path));
+  bool is_npz = reference_path.size() >= 4 && reference_path.compare(reference_path.size() - 4, 4, ".npz") == 0;
+  if (!is_npz) {
+    internal::add_npy(builder, name, file.data(), file.size(), reference);
+    return;
+  }
+  size_t member_size;
+  const char *data = internal::find_npz_member(file.data(), file.size(), member + ".npy", reference, member_size);
+  internal::add_npy(builder, name, data, member_size, reference);
+}
+
+} // namespace httpstan
+#endif // HTTPSTAN_NPY_DATA_HPP
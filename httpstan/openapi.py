@@ -43,11 +43,17 @@ def openapi_spec() -> apispec.APISpec:
     spec.path(path="/v1/models/{model_id}", view=views.handle_delete_model)
     spec.path(path="/v1/models/{model_id}/params", view=views.handle_show_params)
     spec.path(path="/v1/models/{model_id}/log_prob", view=views.handle_log_prob)
+    spec.path(path="/v1/models/{model_id}/log_prob_batch", view=views.handle_log_prob_batch)
     spec.path(path="/v1/models/{model_id}/log_prob_grad", view=views.handle_log_prob_grad)
+    spec.path(path="/v1/models/{model_id}/log_prob_grad_batch", view=views.handle_log_prob_grad_batch)
+    spec.path(path="/v1/models/{model_id}/hessian", view=views.handle_hessian)
+    spec.path(path="/v1/models/{model_id}/hessian_vector_product", view=views.handle_hessian_vector_product)
     spec.path(path="/v1/models/{model_id}/write_array", view=views.handle_write_array)
     spec.path(path="/v1/models/{model_id}/transform_inits", view=views.handle_transform_inits)
     spec.path(path="/v1/models/{model_id}/fits", view=views.handle_create_fit)
     spec.path(path="/v1/models/{model_id}/fits/{fit_id}", view=views.handle_get_fit)
+    spec.path(path="/v1/models/{model_id}/fits/{fit_id}/summary", view=views.handle_get_fit_summary)
+    spec.path(path="/v1/models/{model_id}/summary", view=views.handle_show_summary)
     spec.path(path="/v1/models/{model_id}/fits/{fit_id}", view=views.handle_delete_fit)
     spec.path(path="/v1/operations/{operation_id}", view=views.handle_get_operation)
     apispec.utils.validate_spec(spec)
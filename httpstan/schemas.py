@@ -66,6 +66,8 @@ class Data(marshmallow.Schema):
         """Verify ``data`` dictionary will work for Stan.
 
         Keys should be strings, values must be numbers or (nested) lists of numbers.
+        A value may also be a string naming a ``.npy`` or ``.npz`` file in
+        ``HTTPSTAN_DATA_DIRECTORY``, which is read on the server.
 
         """
         assert not many and not partial, "Use of `many` and `partial` with schema unsupported."
@@ -78,6 +80,8 @@ class Data(marshmallow.Schema):
         for key, value in data.items():
             if isinstance(value, numbers.Number):
                 continue  # scalar value
+            elif isinstance(value, str):
+                continue  # reference to a data file
             elif not is_nested_list_of_numbers(value):
                 raise marshmallow.ValidationError(
                     f"Values associated with `{key}` must be (nested) sequences of numbers."
@@ -119,6 +123,20 @@ class CreateFitRequest(marshmallow.Schema):
     init_buffer = fields.Integer(validate=validate.Range(min=0))
     term_buffer = fields.Integer(validate=validate.Range(min=0))
     window = fields.Integer(validate=validate.Range(min=0))
+    # version of the format of messages in the fit, see ``WriterMessage``
+    message_version = fields.Integer(validate=validate.OneOf([1, 2, 3]))
+    # significant digits of the values in draws, full precision if not set
+    significant_digits = fields.Integer(validate=validate.Range(min=1, max=17))
+    # shell-style patterns of the names of parameters or columns, e.g., `z` or `z.1`, to write in draws;
+    # sampler columns such as `lp__` are always written unless excluded
+    include = fields.List(fields.String(validate=validate.Length(min=1)))
+    exclude = fields.List(fields.String(validate=validate.Length(min=1)))
+    # end sampling once the effective sample size of each parameter matching `target_ess_parameters`,
+    # all parameters if not set, reaches `target_ess`; the fit then has fewer than `num_samples` draws.
+    # Sampling is not ended before 64 draws. The effective sample size of anticorrelated draws exceeds
+    # their number, so the fit may have fewer than `target_ess` draws.
+    target_ess = fields.Number(validate=validate.Range(min=1))
+    target_ess_parameters = fields.List(fields.String(validate=validate.Length(min=1)))
 
 
 class Fit(marshmallow.Schema):
@@ -126,6 +144,40 @@ class Fit(marshmallow.Schema):
     name = fields.String(required=True)
 
 
+class ParameterSummary(marshmallow.Schema):
+    """Summary statistics of the draws of a parameter. Undefined statistics are NaN."""
+
+    mean = fields.Number(required=True)
+    # sample variance
+    variance = fields.Number(required=True)
+    min = fields.Number(required=True)
+    max = fields.Number(required=True)
+    # estimated from t-digests, one for each of the summary's `probabilities`
+    quantiles = fields.List(fields.Number(), required=True)
+    # convergence diagnostics, split-R-hat in summaries of several fits (see `httpstan.summaries`);
+    # the effective sample size of a single fit is estimated by the sample writer (see `httpstan/summary.hpp`)
+    split_rhat = fields.Number()
+    ess = fields.Number()
+
+
+class FitSummary(marshmallow.Schema):
+    """Summary of the draws in a fit, or several fits, excluding warmup draws."""
+
+    num_draws = fields.Integer(required=True)
+    # in summaries of a single fit, true if sampling ended early, see `CreateFitRequest.target_ess`
+    truncated = fields.Boolean()
+    probabilities = fields.List(fields.Number(), required=True)
+    parameters = fields.Dict(keys=fields.String(), values=fields.Nested(ParameterSummary()), required=True)
+
+
+class ShowSummaryRequest(marshmallow.Schema):
+    """Schema for a request for the summary of the draws in several fits."""
+
+    # IDs of fits of the model, e.g., one for each chain
+    fits = fields.List(fields.String(), required=True, validate=validate.Length(min=1))
+    probabilities = fields.List(fields.Number(validate=validate.Range(min=0, max=1)), missing=[0.05, 0.5, 0.95])
+
+
 class ShowParamsRequest(marshmallow.Schema):
     data = fields.Nested(Data(), missing={})
 
@@ -180,12 +232,34 @@ class WriterMessage(marshmallow.Schema):
     The "content" of a message is stored in the field ``values``. This is either
     a list or a mapping.
 
+    In version 2 of the format, requested with ``message_version`` when
+    creating a fit, draws from ``sample_writer`` and ``diagnostic_writer`` do
+    not repeat the names of their values. The names are sent once, in the
+    field ``fields`` of a message without ``values``. Each draw that follows is
+    a bare JSON array of values, not a WriterMessage. Version 3 is version 2
+    with consecutive draws sent together in binary frames of float64 values.
+    The layout of frames is described in ``httpstan/socket_writer.hpp``.
+
+    If ``significant_digits`` is set when creating a fit, values in draws
+    have at most that many significant digits. With 6 or fewer, binary
+    frames hold float32 values.
+
+    If ``include`` or ``exclude`` is set when creating a fit, draws from
+    ``sample_writer`` only have values of the selected columns.
+
     """
 
-    version = fields.Integer(required=True)
+    version = fields.Integer(required=True, validate=validate.OneOf([1, 2, 3]))
     topic = fields.String(required=True, validate=validate.OneOf(["logger", "initialization", "sample", "diagnostic"]))
     # values is either a List or a Mapping. Marshmallow lacks a union type.
-    values = fields.Raw(required=True)
+    values = fields.Raw()
+    # `fields` is reserved by marshmallow.Schema
+    field_names = fields.List(fields.String(), data_key="fields")
+
+    @marshmallow.validates_schema
+    def validate_values(self, data: dict, many: bool, partial: bool) -> None:
+        if ("values" in data) == ("field_names" in data):
+            raise marshmallow.ValidationError("Exactly one of `values` and `fields` must be set.")
 
 
 class ShowLogProbRequest(marshmallow.Schema):
@@ -196,6 +270,14 @@ class ShowLogProbRequest(marshmallow.Schema):
     adjust_transform = fields.Boolean(missing=True)
 
 
+class ShowLogProbBatchRequest(marshmallow.Schema):
+    """Schema for batched log_prob request."""
+
+    data = fields.Nested(Data(), missing={})
+    unconstrained_parameters = fields.List(fields.List(fields.Float()), required=True, validate=validate.Length(min=1))
+    adjust_transform = fields.Boolean(missing=True)
+
+
 class ShowLogProbGradRequest(marshmallow.Schema):
     """Schema for log_prob_grad request."""
 
@@ -204,6 +286,31 @@ class ShowLogProbGradRequest(marshmallow.Schema):
     adjust_transform = fields.Boolean(missing=True)
 
 
+class ShowLogProbGradBatchRequest(marshmallow.Schema):
+    """Schema for batched log_prob_grad request."""
+
+    data = fields.Nested(Data(), missing={})
+    unconstrained_parameters = fields.List(fields.List(fields.Float()), required=True, validate=validate.Length(min=1))
+    adjust_transform = fields.Boolean(missing=True)
+
+
+class ShowHessianRequest(marshmallow.Schema):
+    """Schema for hessian request."""
+
+    data = fields.Nested(Data(), missing={})
+    unconstrained_parameters = fields.List(fields.Float(), required=True)
+    adjust_transform = fields.Boolean(missing=True)
+
+
+class ShowHessianVectorProductRequest(marshmallow.Schema):
+    """Schema for hessian_vector_product request."""
+
+    data = fields.Nested(Data(), missing={})
+    unconstrained_parameters = fields.List(fields.Float(), required=True)
+    vector = fields.List(fields.Float(), required=True)
+    adjust_transform = fields.Boolean(missing=True)
+
+
 class ShowWriteArrayRequest(marshmallow.Schema):
     """Schema for write_array request."""
 
@@ -2,25 +2,21 @@
 
 Functions here perform the menial task of calling (from Python) a named C++
 function in stan::services given a specific Stan model. The output of the
-stan::services function is routed from stan::callbacks writers into Python via a
-Unix domain socket.
+stan::services function is written to the fit by the process calling the
+function. Logger messages are also routed into Python via a Unix domain socket.
 
 """
 import asyncio
-import collections
 import concurrent.futures
 import functools
-import io
 import logging
 import multiprocessing as mp
 import os
-import select
 import socket
+import struct
 import tempfile
 import typing
 
-import lz4.frame
-
 import httpstan.cache
 import httpstan.models
 import httpstan.services.arguments as arguments
@@ -28,9 +24,32 @@ from httpstan.config import HTTPSTAN_DEBUG
 
 # Use `get_context` to get a package-specific multiprocessing context.
 # See "Contexts and start methods" in the `multiprocessing` docs for details.
-executor = concurrent.futures.ProcessPoolExecutor(mp_context=mp.get_context("fork"))
+# Workers are not forked from the server: its threads (see `httpstan.views.executor`) and the TBB threads
+# of the services extension module may hold locks, e.g., of the data cache, which a forked child would
+# inherit locked. Workers are forked from a forkserver process instead, which runs no such threads.
+_mp_context = mp.get_context("forkserver")
+_mp_context.set_forkserver_preload(["httpstan.services_stub"])
+executor = concurrent.futures.ProcessPoolExecutor(mp_context=_mp_context)
 logger = logging.getLogger("httpstan")
 
+# Messages from the logger arrive in frames with a header holding the channel
+# and the length of the message (see `httpstan/transport.hpp`).
+FRAME_HEADER = struct.Struct("<B3xI")
+LOGGER_CHANNEL = 0
+
+def _read_frames(pending: bytearray, logger_callback: typing.Optional[typing.Callable]) -> None:
+    """Pass the messages in the complete frames at the start of `pending` to `logger_callback`."""
+    position = 0
+    while len(pending) - position >= FRAME_HEADER.size:
+        channel, length = FRAME_HEADER.unpack_from(pending, position)
+        end = position + FRAME_HEADER.size + length
+        if end > len(pending):
+            break
+        if logger_callback and channel == LOGGER_CHANNEL:
+            logger_callback(bytes(pending[position + FRAME_HEADER.size : end]))
+        position = end
+    del pending[:position]
+
 
 # This function belongs inside `_make_lazy_function_wrapper`. It is defined here
 # because `pickle` (used by ProcessPoolExecutor) cannot pickle local functions.
@@ -43,13 +62,27 @@ def _make_lazy_function_wrapper_helper(
 
 
 # In order to avoid problems with the ProcessPoolExecutor, the module
-# needs to be loaded inside the spawned process, not before.
+# needs to be loaded inside the worker process, not before.
 def _make_lazy_function_wrapper(function_basename: str, model_name: str) -> typing.Callable:
     # function_basename will be something like "hmc_nuts_diag_e"
     # function_wrapper will refer to a function like "hmc_nuts_diag_e_wrapper"
     return functools.partial(_make_lazy_function_wrapper_helper, function_basename, model_name)
 
 
+async def _read_messages(conn: socket.socket, logger_callback: typing.Optional[typing.Callable]) -> None:
+    """Read logger messages until the process calling the services function closes `conn`."""
+    loop = asyncio.get_running_loop()
+    pending = bytearray()
+    while True:
+        # messages are buffered and sent in chunks of up to 64 KiB
+        chunk = await loop.sock_recv(conn, 65536)
+        if not chunk:
+            # `close` called on other end
+            break
+        pending.extend(chunk)
+        _read_frames(pending, logger_callback)
+
+
 async def call(
     function_name: str,
     model_name: str,
@@ -59,15 +92,16 @@ async def call(
 ) -> None:
     """Call stan::services function.
 
-    Yields (asynchronously) messages from the stan::callbacks writers which are
-    written to by the stan::services function.
+    Waits (asynchronously) for the function to return, passing messages from
+    the stan::callbacks logger to `logger_callback` as they arrive. No polling
+    is involved: the event loop is woken when messages arrive.
 
     This is a coroutine function.
 
     Arguments:
         function_name: full name of function in stan::services
         services_module (module): model-specific services extension module
-        fit_name: Name of fit, used for saving length-prefixed messages
+        fit_name: Name of fit, written by the process calling the function
         logger_callback: Callback function for logger messages, including sampling progress messages
         kwargs: named stan::services function arguments, see CmdStan documentation.
     """
@@ -87,14 +121,20 @@ async def call(
         if arg not in kwargs:
             kwargs[arg] = typing.cast(typing.Any, arguments.lookup_default(arguments.Method[method.upper()], arg))
 
+    # the process calling the function writes the fit to a temporary file in
+    # this directory and renames it when the call ends
+    fit_path = httpstan.cache.fit_path(fit_name)
+    fit_path.parent.mkdir(parents=True, exist_ok=True)
     with socket.socket(socket.AF_UNIX, type=socket.SOCK_STREAM) as socket_:
         _, socket_filename = tempfile.mkstemp(prefix="httpstan_", suffix=".sock")
         os.unlink(socket_filename)
         socket_.bind(socket_filename)
-        socket_.listen(4)  # three stan callback writers, one stan callback logger
+        socket_.listen(1)  # one connection shared by the stan callback writers and logger
 
         lazy_function_wrapper = _make_lazy_function_wrapper(function_basename, model_name)
-        lazy_function_wrapper_partial = functools.partial(lazy_function_wrapper, socket_filename, **kwargs)
+        lazy_function_wrapper_partial = functools.partial(
+            lazy_function_wrapper, socket_filename, str(fit_path), **kwargs
+        )
 
         # If HTTPSTAN_DEBUG is set block until sampling is complete. Do not use an executor.
         if HTTPSTAN_DEBUG:  # pragma: no cover
@@ -105,49 +145,31 @@ async def call(
         else:
             future = asyncio.get_running_loop().run_in_executor(executor, lazy_function_wrapper_partial)  # type: ignore
 
-        messages_files: typing.Mapping[socket.socket, io.BytesIO] = collections.defaultdict(io.BytesIO)
-        potential_readers = [socket_]
-        while True:
-            # note: timeout of 0.01 seems to work well based on measurements
-            readable, writeable, errored = select.select(potential_readers, [], [], 0.01)
-            for s in readable:
-                if s is socket_:
-                    conn, _ = s.accept()
-                    logger.debug("Opened socket connection to a socket_logger or socket_writer.")
-                    potential_readers.append(conn)
-                    continue
-                message = s.recv(8192)
-                if not len(message):
-                    # `close` called on other end
-                    s.close()
-                    logger.debug("Closed socket connection to a socket_logger or socket_writer.")
-                    potential_readers.remove(s)
-                    continue
-                # Only trigger callback if message has topic `logger`.
-                if logger_callback and b'"logger"' in message:
-                    logger_callback(message)
-                messages_files[s].write(message)
-            # if `potential_readers == [socket_]` then either (1) no connections
-            # have been opened or (2) all connections have been closed.
-            if not readable:
-                if potential_readers == [socket_] and future.done():
-                    logger.debug(
-                        f"Stan services function `{function_basename}` returned without problems or raised a C++ exception."
-                    )
-                    break
-                # no messages right now and not done. Sleep briefly so other pending tasks get a chance to run.
-                await asyncio.sleep(0.001)
-
-    # WISHLIST: Here we compress messages after they all have arrived. Find a way to compress
-    # messages as they arrive.  Compressing messages as they arrive would use much less memory.
-    with lz4.frame.LZ4FrameCompressor() as compressor:
-        compressed = compressor.begin()
-        for fh in messages_files.values():
-            fh.flush()
-            compressed += compressor.compress(fh.getvalue())
-            fh.close()
-        compressed += compressor.flush()
-    httpstan.cache.dump_fit(compressed, fit_name)
+        loop = asyncio.get_running_loop()
+        socket_.setblocking(False)
+        accept = asyncio.ensure_future(loop.sock_accept(socket_))
+        try:
+            await asyncio.wait({accept, future}, return_when=asyncio.FIRST_COMPLETED)
+            conn: typing.Optional[socket.socket] = None
+            if accept.done():
+                conn, _ = accept.result()
+            else:
+                # The function returned. A connection it made may not have been accepted yet.
+                accept.cancel()
+                try:
+                    conn, _ = socket_.accept()
+                    conn.setblocking(False)
+                except BlockingIOError:
+                    logger.debug(f"Stan services function `{function_basename}` returned without connecting.")
+            if conn is not None:
+                with conn:
+                    logger.debug("Opened socket connection to the stan callback logger.")
+                    await _read_messages(conn, logger_callback)
+                    logger.debug("Closed socket connection to the stan callback logger.")
+            await asyncio.wait({future})
+        finally:
+            accept.cancel()
+            os.unlink(socket_filename)
 
     # `result()` method will raise exceptions, if any
     future.result()
@@ -1,7 +1,6 @@
 #ifndef HTTPSTAN_SOCKET_LOGGER_HPP
 #define HTTPSTAN_SOCKET_LOGGER_HPP
 
-#include <boost/asio.hpp>
 #include <iostream>
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
@@ -9,12 +8,7 @@
 #include <stan/callbacks/logger.hpp>
 #include <string>
 
-/**
- * NOTE: httpstan makes an unorthodox use of `message_prefix`!
- *
- * See discussion in httpstan/socket_writer.hpp
- *
- */
+#include "transport.hpp"
 
 namespace stan {
 namespace callbacks {
@@ -22,49 +16,31 @@ namespace callbacks {
 /**
  * <code>socket_logger</code> is an implementation
  * of <code>logger</code> that writes to a socket.
+ *
+ * Messages are sent through a <code>httpstan::transport</code> shared
+ * with the writers. Warnings and errors are sent immediately.
  */
 class socket_logger : public logger {
 private:
   /**
    * Output socket
    */
-  boost::asio::io_service io_service;
-  boost::asio::local::stream_protocol::socket socket;
-
-  /**
-   * Channel name with which to prefix strings sent to the socket.
-   */
-  std::string message_prefix_;
+  httpstan::transport &transport_;
 
   /**
-   * Send a JSON message followed by a newline to a socket.
+   * Send a JSON message followed by a newline to the socket.
    */
-  std::size_t send_message(const rapidjson::StringBuffer &buffer,
-                           boost::asio::local::stream_protocol::socket &socket) {
-    boost::asio::streambuf stream_buffer;
-    std::ostream output_stream(&stream_buffer);
-    output_stream << buffer.GetString() << "\n";
-    return boost::asio::write(socket, stream_buffer);
+  void send_message(const rapidjson::StringBuffer &buffer) {
+    transport_.write_line(httpstan::channel::logger, buffer.GetString(), buffer.GetSize());
   }
 
 public:
   /**
-   * Constructs a logger with an output socket
-   * and an optional prefix for comments.
+   * Constructs a logger which sends messages through a transport.
    *
-   * @param[in, out] output socket
-   * @param[in] message_prefix will be prefixed to each string which is sent to the socket. Default is "".
-   */
-  explicit socket_logger(const std::string &socket_filename, const std::string &message_prefix = "")
-      : socket(io_service), message_prefix_(message_prefix) {
-    boost::asio::local::stream_protocol::endpoint ep(socket_filename);
-    socket.connect(ep);
-  }
-
-  /**
-   * Destructor
+   * @param[in, out] transport connection shared with the writers
    */
-  ~socket_logger() { socket.close(); }
+  explicit socket_logger(httpstan::transport &transport) : transport_(transport) {}
 
   /**
    * Logs a message with debug log level
@@ -89,7 +65,7 @@ public:
 
     writer.EndObject();
 
-    send_message(buffer, socket);
+    send_message(buffer);
   }
 
   /**
@@ -115,7 +91,7 @@ public:
 
     writer.EndObject();
 
-    send_message(buffer, socket);
+    send_message(buffer);
   }
 
   void info(const std::string &message) {
@@ -136,7 +112,7 @@ public:
 
     writer.EndObject();
 
-    send_message(buffer, socket);
+    send_message(buffer);
   }
 
   void info(const std::stringstream &message) {
@@ -157,7 +133,7 @@ public:
 
     writer.EndObject();
 
-    send_message(buffer, socket);
+    send_message(buffer);
   }
 
   void warn(const std::string &message) {
@@ -178,7 +154,8 @@ public:
 
     writer.EndObject();
 
-    send_message(buffer, socket);
+    send_message(buffer);
+    transport_.flush();
   }
 
   void warn(const std::stringstream &message) {
@@ -199,7 +176,8 @@ public:
 
     writer.EndObject();
 
-    send_message(buffer, socket);
+    send_message(buffer);
+    transport_.flush();
   }
 
   void error(const std::string &message) {
@@ -220,7 +198,8 @@ public:
 
     writer.EndObject();
 
-    send_message(buffer, socket);
+    send_message(buffer);
+    transport_.flush();
   }
 
   void error(const std::stringstream &message) {
@@ -241,7 +220,8 @@ public:
 
     writer.EndObject();
 
-    send_message(buffer, socket);
+    send_message(buffer);
+    transport_.flush();
   }
 
   void fatal(const std::string &message) {
@@ -262,7 +242,8 @@ public:
 
     writer.EndObject();
 
-    send_message(buffer, socket);
+    send_message(buffer);
+    transport_.flush();
   }
 
   void fatal(const std::stringstream &message) {
@@ -283,7 +264,8 @@ public:
 
     writer.EndObject();
 
-    send_message(buffer, socket);
+    send_message(buffer);
+    transport_.flush();
   }
 };
 
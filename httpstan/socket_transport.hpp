@@ -0,0 +1,50 @@
+#ifndef HTTPSTAN_SOCKET_TRANSPORT_HPP
+#define HTTPSTAN_SOCKET_TRANSPORT_HPP
+
+#include <boost/asio.hpp>
+#include <cstddef>
+#include <string>
+
+#include "transport.hpp"
+
+namespace httpstan {
+
+/**
+ * <code>socket_transport</code> is a <code>transport</code> which sends
+ * frames over a connection to a Unix domain socket.
+ */
+class socket_transport : public transport {
+private:
+  boost::asio::io_service io_service_;
+  boost::asio::local::stream_protocol::socket socket_;
+
+protected:
+  void send(const char *data, std::size_t size) override {
+    boost::asio::write(socket_, boost::asio::buffer(data, size));
+  }
+
+public:
+  /**
+   * Connect to a socket.
+   *
+   * @param[in] socket_filename path of the socket
+   * @param[in] fit_filename path of the fit
+   */
+  socket_transport(const std::string &socket_filename, const std::string &fit_filename)
+      : transport(fit_filename), socket_(io_service_) {
+    boost::asio::local::stream_protocol::endpoint ep(socket_filename);
+    socket_.connect(ep);
+  }
+
+  /**
+   * Commits the fit, sends buffered messages and closes the socket. Errors are ignored.
+   */
+  ~socket_transport() {
+    finish_noexcept();
+    boost::system::error_code ec;
+    socket_.close(ec);
+  }
+};
+
+} // namespace httpstan
+#endif // HTTPSTAN_SOCKET_TRANSPORT_HPP
@@ -1,25 +1,32 @@
 #ifndef HTTPSTAN_SOCKET_WRITER_HPP
 #define HTTPSTAN_SOCKET_WRITER_HPP
 
-#include <boost/asio.hpp>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fnmatch.h>
+#include <stdexcept>
 #include <iostream>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
 #include <stan/callbacks/writer.hpp>
 #include <string>
 #include <vector>
 
+#include "summary.hpp"
+#include "transport.hpp"
+
 /**
- * NOTE: httpstan makes use of `message_prefix` in an unexpected way!
- *
- * httpstan uses `message_prefix` to record what messages the socket_writer instance is receiving.
- * In a call to `hmc_nuts_diag_e_adapt`, three socket_writers are used:
+ * In a call to `hmc_nuts_diag_e_adapt`, three writers are used:
  * 1. init_writer
  * 2. sample_writer
  * 3. diagnostic_writer
  *
- * httpstan uses `message_prefix` to allow the socket_writer to know in what
- * context it is being used.  identity of the socket_writer. For example, the
- * diagnostic writer uses the string `diagnostic_writer:` (note the colon) as
- * its message_prefix.
+ * Each writer receives different messages and has its own class:
+ * <code>init_socket_writer</code>, <code>sample_socket_writer</code> and
+ * <code>diagnostic_socket_writer</code>. What to do with a message is decided
+ * by the type of the writer rather than by a check on every call.
  *
  * Additional background:
  *
@@ -42,6 +49,44 @@
  *   sample_writer:"Diagonal elements of inverse mass matrix:"
  *   sample_writer:0.961989
  *
+ * Messages are JSON objects with fields ``version``, ``topic`` and ``values``.
+ * In version 1, each draw written by ``sample_writer`` or ``diagnostic_writer``
+ * is an object mapping field names to values. Field names take up most of the
+ * space used by draws of models with many parameters. In version 2, field names
+ * are sent once, in a message with a ``fields`` member, and each draw is a bare
+ * JSON array of values in the same order:
+ *   {"version":2,"topic":"sample","fields":["lp__","accept_stat__",...,"y"]}
+ *   [-3.16745e-06,0.999965,1,2,3,0,0.0142087,0.00251692]
+ * Version 3 is version 2 with draws sent as binary frames rather than text.
+ * A frame is a 24-byte header followed by raw values. All numbers are
+ * little-endian:
+ *   offset 0, uint8: 0xFF, a byte which never occurs in UTF-8 encoded JSON
+ *   offset 1, uint8: channel, 1 for ``sample_writer``, 2 for ``diagnostic_writer`` (see ``httpstan::channel``)
+ *   offset 2, uint8: size of each value in bytes, 8 for float64 or 4 for float32
+ *   offset 3, uint8: reserved, 0
+ *   offset 4, uint32: chain
+ *   offset 8, uint32: index of the first draw in the frame among draws sent by the writer
+ *   offset 12, uint32: number of draws in the frame
+ *   offset 16, uint32: number of values in each draw
+ *   offset 20, uint32: length of the values in bytes
+ *   offset 24: values, draw after draw
+ * Consecutive draws are collected in one frame, which is written when its
+ * values reach 64 KiB, before any other message of the writer and at the end
+ * of the call (see <code>socket_writer::flush_draws</code>).
+ * Other messages are the same in all versions, apart from ``version``.
+ *
+ * Draws may be sent with fewer significant digits (``significant_digits``,
+ * 1 to 17). In JSON, values are then written with at most that many digits.
+ * In binary frames, values are sent as float32 if it represents that many
+ * digits exactly (6 or fewer) and as float64 otherwise. Initial values and
+ * messages other than draws are not affected.
+ *
+ * The sample writer may write only some of the columns of each draw
+ * (``include`` and ``exclude``, lists of shell-style patterns matched with
+ * fnmatch). A pattern matches a column name, e.g., ``z.1``, or the name of
+ * the parameter the column belongs to, e.g., ``z``. Columns are selected
+ * once, when the column header arrives. Sampler columns, whose names end in
+ * ``__``, are only left out if excluded.
  */
 
 namespace stan {
@@ -56,270 +101,498 @@ enum class ProcessingAdaptationState {
 };
 
 /**
- * <code>socket_writer</code> is an implementation
- * of <code>writer</code> that writes JSON-encoded values to a socket.
+ * <code>socket_writer</code> is the base of the writers which send
+ * JSON-encoded values to the server. It holds what the writers share: the
+ * channel, the message version and the functions which encode messages.
+ *
+ * Messages are sent through a <code>httpstan::transport</code> shared
+ * with the other callbacks.
  */
 class socket_writer : public writer {
-private:
+protected:
+  using json_writer = rapidjson::Writer<rapidjson::StringBuffer, rapidjson::UTF8<>, rapidjson::UTF8<>,
+                                        rapidjson::CrtAllocator, rapidjson::kWriteNanAndInfFlag>;
+
+  httpstan::transport &transport_;
+  const httpstan::channel channel_;
+  const int message_version_;
+  const unsigned int chain_;
+  // significant digits of the values in draws, 0 for full precision
+  const int significant_digits_;
+  // number of draws in binary frames written so far, the index of the first draw of the next frame
+  uint32_t num_draws_ = 0;
+  // the binary frame being filled: header, then the values of `frame_draws_` draws of `frame_values_` values
+  std::vector<char> frame_;
+  uint32_t frame_draws_ = 0;
+  uint32_t frame_values_ = 0;
+
+  static constexpr std::size_t frame_header_size = 24;
+  // size of the values after which a frame is written
+  static constexpr std::size_t max_frame_bytes = 64 * 1024;
+
   /**
-   * Output
+   * Returns the size in bytes of each value in binary frames.
    */
+  std::size_t value_size() const {
+    // float32 holds any decimal number with 6 significant digits
+    return significant_digits_ > 0 && significant_digits_ <= 6 ? sizeof(float) : sizeof(double);
+  }
 
-  boost::asio::io_service io_service;
-  boost::asio::local::stream_protocol::socket socket;
+  /**
+   * @param[in, out] transport connection shared with the other callbacks
+   * @param[in] channel channel of the writer
+   * @param[in] message_version version of the message format, 1, 2 or 3
+   * @param[in] chain chain identifier, recorded in binary frames
+   * @param[in] significant_digits significant digits of the values in draws, 1 to 17, or 0 for full precision
+   */
+  socket_writer(httpstan::transport &transport, httpstan::channel channel, int message_version, unsigned int chain,
+                int significant_digits)
+      : transport_(transport),
+        channel_(channel),
+        message_version_(message_version),
+        chain_(chain),
+        significant_digits_(significant_digits) {
+    if (message_version < 1 || message_version > 3)
+      throw std::invalid_argument("Message version must be 1, 2 or 3.");
+    if (significant_digits < 0 || significant_digits > 17)
+      throw std::invalid_argument("Significant digits must be between 1 and 17, or 0 for full precision.");
+  }
 
   /**
-   * Channel name with which to prefix strings sent to the socket.
+   * Write a value of a draw, with at most `significant_digits_` significant digits.
    */
-  std::string message_prefix_;
-  std::vector<std::string> diagnostic_fields_;
-  std::vector<std::string> sample_fields_;
-  ProcessingAdaptationState processing_adaptation_state_ = ProcessingAdaptationState::BEFORE_PROCESSING_ADAPTATION;
+  void write_value(json_writer &writer, double value) const {
+    if (significant_digits_ == 0 || !std::isfinite(value)) {
+      writer.Double(value);
+      return;
+    }
+    char digits[32];
+    int length = std::snprintf(digits, sizeof(digits), "%.*g", significant_digits_, value);
+    writer.RawValue(digits, static_cast<std::size_t>(length), rapidjson::kNumberType);
+  }
 
   /**
-   * Send a JSON message followed by a newline to a socket.
+   * Send a JSON message followed by a newline to the socket, after any draws collected in a binary frame.
    */
-  std::size_t send_message(const rapidjson::StringBuffer &buffer,
-                           boost::asio::local::stream_protocol::socket &socket) {
-    boost::asio::streambuf stream_buffer;
-    std::ostream output_stream(&stream_buffer);
-    output_stream << buffer.GetString() << "\n";
-    return boost::asio::write(socket, stream_buffer);
+  void send_message(const rapidjson::StringBuffer &buffer) {
+    flush_draws();
+    transport_.write_line(channel_, buffer.GetString(), buffer.GetSize());
   }
 
-public:
   /**
-   * Constructs a writer with an output socket
-   * and an optional prefix for comments.
-   *
-   * @param[in, out] output ostream
-   * @param[in] message_prefix will be prefixed to each string which is sent to the socket. Default is "".
+   * Send a message with a single string value.
    */
-  explicit socket_writer(const std::string &socket_filename, const std::string &message_prefix = "")
-      : socket(io_service), message_prefix_(message_prefix) {
-    boost::asio::local::stream_protocol::endpoint ep(socket_filename);
-    socket.connect(ep);
+  void send_string(const char *topic, const std::string &message) {
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    writer.StartObject();
+    writer.String("version");
+    writer.Int(message_version_);
+    writer.String("topic");
+    writer.String(topic);
+    writer.String("values");
+    writer.StartArray();
+    writer.String(message.c_str());
+    writer.EndArray();
+    writer.EndObject();
+    send_message(buffer);
   }
 
   /**
-   * Destructor
+   * Send the names of the values in each draw (version 2 only).
    */
-  ~socket_writer() { socket.close(); }
+  void send_fields(const char *topic, const std::vector<std::string> &fields) {
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    writer.StartObject();
+    writer.String("version");
+    writer.Int(message_version_);
+    writer.String("topic");
+    writer.String(topic);
+    writer.String("fields");
+    writer.StartArray();
+    for (const std::string &field : fields)
+      writer.String(field.c_str());
+    writer.EndArray();
+    writer.EndObject();
+    send_message(buffer);
+  }
 
   /**
-   * Writes a sequence of names.
-   *
-   * @param[in] names Names in a std::vector
+   * Add a draw to the binary frame being filled (version 3 only).
    */
-  void operator()(const std::vector<std::string> &names) {
-    std::vector<std::string>::const_iterator last = names.end();
-    if (message_prefix_ == "diagnostic_writer:") {
-      if (diagnostic_fields_.empty()) {
-        for (std::vector<std::string>::const_iterator it = names.begin(); it != last; ++it) {
-          diagnostic_fields_.push_back(*it);
-        }
-        return;
+  void send_frame(const std::vector<double> &state) {
+    const std::size_t size = value_size();
+    if (frame_draws_ > 0
+        && (state.size() != frame_values_ || frame_.size() - frame_header_size + state.size() * size > max_frame_bytes))
+      flush_draws();
+    if (frame_draws_ == 0) {
+      frame_.assign(frame_header_size, 0);
+      frame_values_ = static_cast<uint32_t>(state.size());
+    }
+    const std::size_t offset = frame_.size();
+    frame_.resize(offset + state.size() * size);
+    // IEEE 754 values in host byte order, which is little-endian on all platforms httpstan supports
+    if (size == sizeof(float)) {
+      for (size_t i = 0; i < state.size(); ++i) {
+        const float value = static_cast<float>(state[i]);
+        std::memcpy(frame_.data() + offset + i * sizeof(float), &value, sizeof(float));
       }
+    } else if (!state.empty()) {
+      std::memcpy(frame_.data() + offset, state.data(), state.size() * sizeof(double));
+    }
+    ++frame_draws_;
+  }
 
-      rapidjson::StringBuffer buffer;
-      rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-      writer.StartObject();
+  /**
+   * Send a draw as a bare array of values (version 2 only).
+   */
+  void send_values(const std::vector<double> &state) {
+    rapidjson::StringBuffer buffer;
+    json_writer writer(buffer);
+    writer.StartArray();
+    for (double value : state)
+      write_value(writer, value);
+    writer.EndArray();
+    send_message(buffer);
+  }
 
-      writer.String("version");
-      writer.Int(1);
-      writer.String("topic");
-      writer.String("diagnostic");
+  /**
+   * Send a draw in the format of the message version.
+   */
+  void send_draw(const char *topic, const std::vector<std::string> &fields, const std::vector<double> &state) {
+    if (message_version_ == 3) {
+      send_frame(state);
+      return;
+    }
+    if (message_version_ == 2) {
+      send_values(state);
+      return;
+    }
 
-      writer.String("values");
-      writer.StartArray();
+    rapidjson::StringBuffer buffer;
+    json_writer writer(buffer);
+    writer.StartObject();
 
-      for (std::vector<std::string>::const_iterator it = names.begin(); it != last; ++it) {
-        writer.String(it->c_str());
-      }
-      writer.EndArray();
+    writer.String("version");
+    writer.Int(message_version_);
+    writer.String("topic");
+    writer.String(topic);
 
-      send_message(buffer, socket);
-      return;
+    writer.String("values");
+    writer.StartObject();
+    for (std::size_t i = 0; i < fields.size(); ++i) {
+      writer.String(fields[i].c_str());
+      write_value(writer, state[i]);
+    }
+    writer.EndObject();
 
-    } else if (message_prefix_ == "init_writer:") {
-      throw std::runtime_error("Unexpected string vector for init writer.");
-    } else if (message_prefix_ == "sample_writer:") {
-      // sample writer receives only one string vector message, the column header
-      if (!sample_fields_.empty())
-        throw std::runtime_error("Unexpected string vector in sample writer after column header.");
-      for (std::vector<std::string>::const_iterator it = names.begin(); it != last; ++it) {
-        sample_fields_.push_back(*it);
-      }
-      return;
+    writer.EndObject();
+
+    send_message(buffer);
+  }
+
+public:
+  /**
+   * Writes draws which are not yet written, ignoring errors. Call <code>flush_draws</code> first to see errors.
+   */
+  ~socket_writer() {
+    try {
+      flush_draws();
+    } catch (...) {
     }
   }
 
   /**
-   * Writes a set of values.
-   *
-   * @param[in] state Values in a std::vector
+   * Writes the binary frame being filled, if it holds any draws.
+   */
+  void flush_draws() {
+    if (frame_draws_ == 0)
+      return;
+    const uint32_t length = static_cast<uint32_t>(frame_.size() - frame_header_size);
+    const uint32_t header_values[] = {static_cast<uint32_t>(chain_), num_draws_, frame_draws_, frame_values_, length};
+    frame_[0] = static_cast<char>(0xFF);
+    frame_[1] = static_cast<char>(channel_);
+    frame_[2] = static_cast<char>(value_size());
+    frame_[3] = 0;
+    for (size_t i = 0; i < 5; ++i)
+      for (size_t j = 0; j < 4; ++j)
+        frame_[4 + 4 * i + j] = static_cast<char>((header_values[i] >> (8 * j)) & 0xFF);
+    num_draws_ += frame_draws_;
+    frame_draws_ = 0;
+    transport_.write(channel_, frame_.data(), frame_.size());
+    frame_.clear();
+  }
+
+  /**
+   * Writes the message_prefix to the stream followed by a newline.
+   */
+  void operator()() {
+    // unused
+    return;
+  }
+};
+
+/**
+ * <code>init_socket_writer</code> writes the unconstrained initial values.
+ * It receives no names or strings.
+ */
+class init_socket_writer : public socket_writer {
+public:
+  /**
+   * @param[in, out] transport connection shared with the other callbacks
    */
+  explicit init_socket_writer(httpstan::transport &transport)
+      : socket_writer(transport, httpstan::channel::init_writer, 1, 0, 0) {}
+
+  using socket_writer::operator();
+
+  void operator()(const std::vector<std::string> &) {
+    throw std::runtime_error("Unexpected string vector for init writer.");
+  }
+
   void operator()(const std::vector<double> &state) {
-    std::vector<double>::const_iterator last = state.end();
+    rapidjson::StringBuffer buffer;
+    json_writer writer(buffer);
+    writer.StartObject();
 
-    if (message_prefix_ == "diagnostic_writer:") {
-      if (diagnostic_fields_.empty()) {
-        throw std::runtime_error("diagnostic fields must be set before receiving values");
-      }
+    writer.String("version");
+    writer.Int(message_version_);
+    writer.String("topic");
+    writer.String("initialization");
 
-      rapidjson::StringBuffer buffer;
-      rapidjson::Writer<rapidjson::StringBuffer, rapidjson::UTF8<>, rapidjson::UTF8<>, rapidjson::CrtAllocator,
-                        rapidjson::kWriteNanAndInfFlag>
-          writer(buffer);
-      writer.StartObject();
-
-      writer.String("version");
-      writer.Int(1);
-      writer.String("topic");
-      writer.String("diagnostic");
-
-      writer.String("values");
-      writer.StartObject();
-      for (std::size_t i = 0; i < diagnostic_fields_.size(); ++i) {
-        writer.String(diagnostic_fields_[i].c_str());
-        writer.Double(state[i]);
-      }
-      writer.EndObject();
+    writer.String("values");
+    writer.StartArray();
+    for (double value : state)
+      writer.Double(value);
+    writer.EndArray();
 
-      writer.EndObject();
+    writer.EndObject();
 
-      send_message(buffer, socket);
-      return;
-    } else if (message_prefix_ == "init_writer:") {
-      rapidjson::StringBuffer buffer;
-      rapidjson::Writer<rapidjson::StringBuffer, rapidjson::UTF8<>, rapidjson::UTF8<>, rapidjson::CrtAllocator,
-                        rapidjson::kWriteNanAndInfFlag>
-          writer(buffer);
-      writer.StartObject();
-
-      writer.String("version");
-      writer.Int(1);
-      writer.String("topic");
-      writer.String("initialization");
-
-      writer.String("values");
-      writer.StartArray();
-      for (std::vector<double>::const_iterator it = state.begin(); it != last; ++it) {
-        writer.Double(*it);
-      }
-      writer.EndArray();
+    send_message(buffer);
+  }
 
-      writer.EndObject();
+  void operator()(const std::string &) { throw std::runtime_error("Unexpected string for init writer."); }
+};
 
-      send_message(buffer, socket);
-      return;
-    } else if (message_prefix_ == "sample_writer:") {
-      if (sample_fields_.empty())
-        throw std::runtime_error("Sample fields should be populated before sample writer writes a vector of doubles.");
-
-      if ((processing_adaptation_state_ == ProcessingAdaptationState::PROCESSING_ADAPTATION) ||
-          (processing_adaptation_state_ == ProcessingAdaptationState::FINAL_ADAPTATION_MESSAGE))
-        throw std::runtime_error("Adaptation should have completed before sample writer writes a vector of doubles.");
-
-      rapidjson::StringBuffer buffer;
-      rapidjson::Writer<rapidjson::StringBuffer, rapidjson::UTF8<>, rapidjson::UTF8<>, rapidjson::CrtAllocator,
-                        rapidjson::kWriteNanAndInfFlag>
-          writer(buffer);
-      writer.StartObject();
-
-      writer.String("version");
-      writer.Int(1);
-      writer.String("topic");
-      writer.String("sample");
-
-      writer.String("values");
-      writer.StartObject();
-      for (std::size_t i = 0; i < sample_fields_.size(); ++i) {
-        writer.String(sample_fields_[i].c_str());
-        writer.Double(state[i]);
-      }
-      writer.EndObject();
+/**
+ * <code>sample_socket_writer</code> writes draws. It receives the column
+ * header once, then adaptation messages (if any) and draws.
+ *
+ * It also keeps a summary of the draws. Draws which precede the end of
+ * adaptation are warmup draws and are left out of the summary. Columns which
+ * are not selected are left out of the draws and of the summary.
+ */
+class sample_socket_writer : public socket_writer {
+private:
+  // names of the selected columns
+  std::vector<std::string> fields_;
+  ProcessingAdaptationState processing_adaptation_state_ = ProcessingAdaptationState::BEFORE_PROCESSING_ADAPTATION;
+  httpstan::summary summary_;
+  const std::vector<std::string> include_;
+  const std::vector<std::string> exclude_;
+  // number of columns in the column header
+  std::size_t num_columns_ = 0;
+  // indices of the selected columns, empty if all columns are selected
+  std::vector<std::size_t> selection_;
+  // values of the selected columns of the current draw
+  std::vector<double> selected_state_;
+
+  /**
+   * Returns the values of the selected columns of a draw.
+   */
+  const std::vector<double> &select(const std::vector<double> &state) {
+    if (state.size() != num_columns_)
+      throw std::runtime_error("Draw and column header have different numbers of values.");
+    selected_state_.resize(selection_.size());
+    for (std::size_t i = 0; i < selection_.size(); ++i)
+      selected_state_[i] = state[selection_[i]];
+    return selected_state_;
+  }
 
-      writer.EndObject();
+public:
+  /**
+   * Returns true if a pattern matches the column or the parameter it belongs to.
+   */
+  static bool matches(const std::vector<std::string> &patterns, const std::string &name) {
+    const std::string parameter = name.substr(0, name.find('.'));
+    for (const std::string &pattern : patterns)
+      if (fnmatch(pattern.c_str(), name.c_str(), 0) == 0 || fnmatch(pattern.c_str(), parameter.c_str(), 0) == 0)
+        return true;
+    return false;
+  }
 
-      send_message(buffer, socket);
-      return;
+  /**
+   * @param[in, out] transport connection shared with the other callbacks
+   * @param[in] message_version version of the message format, 1, 2 or 3. Default is 1.
+   * @param[in] chain chain identifier, recorded in binary frames. Default is 0.
+   * @param[in] significant_digits significant digits of the values in draws. Default is 0, full precision.
+   * @param[in] include patterns of the columns to write. Default is empty, all columns.
+   * @param[in] exclude patterns of the columns not to write. Default is empty, no columns.
+   */
+  explicit sample_socket_writer(httpstan::transport &transport, int message_version = 1, unsigned int chain = 0,
+                                int significant_digits = 0, const std::vector<std::string> &include = {},
+                                const std::vector<std::string> &exclude = {})
+      : socket_writer(transport, httpstan::channel::sample_writer, message_version, chain, significant_digits),
+        include_(include),
+        exclude_(exclude) {}
+
+  using socket_writer::operator();
+
+  /**
+   * Writes the column header, the only string vector the sample writer receives.
+   *
+   * @param[in] names Names in a std::vector
+   */
+  void operator()(const std::vector<std::string> &names) {
+    if (!fields_.empty())
+      throw std::runtime_error("Unexpected string vector in sample writer after column header.");
+    num_columns_ = names.size();
+    for (std::size_t i = 0; i < names.size(); ++i) {
+      const std::string &name = names[i];
+      const bool sampler = name.size() >= 2 && name.compare(name.size() - 2, 2, "__") == 0;
+      if ((include_.empty() || sampler || matches(include_, name)) && !matches(exclude_, name)) {
+        selection_.push_back(i);
+        fields_.push_back(name);
+      }
     }
+    if (fields_.empty())
+      throw std::invalid_argument("No columns match the include and exclude patterns.");
+    // draws are copied only if some columns are left out
+    if (selection_.size() == names.size())
+      selection_.clear();
+    summary_.set_names(fields_);
+    if (message_version_ >= 2)
+      send_fields("sample", fields_);
   }
 
   /**
-   * Writes the message_prefix to the stream followed by a newline.
+   * Writes a draw, or the diagonal of the inverse mass matrix at the end of adaptation.
+   *
+   * @param[in] state Values in a std::vector
    */
-  void operator()() {
-    // unused
-    return;
+  void operator()(const std::vector<double> &state) {
+    if (fields_.empty())
+      throw std::runtime_error("Sample fields should be populated before sample writer writes a vector of doubles.");
+
+    if ((processing_adaptation_state_ == ProcessingAdaptationState::PROCESSING_ADAPTATION) ||
+        (processing_adaptation_state_ == ProcessingAdaptationState::FINAL_ADAPTATION_MESSAGE))
+      throw std::runtime_error("Adaptation should have completed before sample writer writes a vector of doubles.");
+    const std::vector<double> &draw = selection_.empty() ? state : select(state);
+    summary_.add(draw);
+    send_draw("sample", fields_, draw);
   }
 
   /**
-   * Writes the message_prefix then the message.
+   * Writes a message about adaptation.
    *
    * @param[in] message A string
    */
   void operator()(const std::string &message) {
-    if (message_prefix_ == "diagnostic_writer:") {
-      rapidjson::StringBuffer buffer;
-      rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-      writer.StartObject();
+    // state machine dance here
+    if (processing_adaptation_state_ == ProcessingAdaptationState::BEFORE_PROCESSING_ADAPTATION) {
+      if (message.rfind("Adaptation terminated", 0) == 0) {
+        // message starts with "Adaptation terminated", draws so far were warmup draws
+        processing_adaptation_state_ = ProcessingAdaptationState::PROCESSING_ADAPTATION;
+        summary_.reset();
+      }
+    } else if (processing_adaptation_state_ == ProcessingAdaptationState::PROCESSING_ADAPTATION) {
+      if (message.rfind("Diagonal elements of inverse mass matrix", 0) == 0) {
+        // message starts with "Diagonal elements of inverse mass matrix"
+        // the next "message" (vector of doubles) will be the final adaptation message
+        processing_adaptation_state_ = ProcessingAdaptationState::FINAL_ADAPTATION_MESSAGE;
+      }
+    } else if (processing_adaptation_state_ == ProcessingAdaptationState::FINAL_ADAPTATION_MESSAGE) {
+      // this message is the last adaptation-related message before normal draws start arriving
+      processing_adaptation_state_ = ProcessingAdaptationState::AFTER_PROCESSING_ADAPTATION;
+    }
+    send_string("sample", message);
+  }
+
+  /**
+   * Returns the summary of the draws written so far, excluding warmup draws.
+   */
+  const httpstan::summary &summary() const { return summary_; }
+
+  /**
+   * Returns true once adaptation has terminated. Draws written before are warmup draws.
+   */
+  bool adaptation_terminated() const {
+    return processing_adaptation_state_ != ProcessingAdaptationState::BEFORE_PROCESSING_ADAPTATION;
+  }
+};
 
-      writer.String("version");
-      writer.Int(1);
-      writer.String("topic");
-      writer.String("diagnostic");
+/**
+ * <code>diagnostic_socket_writer</code> writes the sampler diagnostics of
+ * each draw. The first string vector it receives is the column header.
+ */
+class diagnostic_socket_writer : public socket_writer {
+private:
+  std::vector<std::string> fields_;
 
-      writer.String("values");
-      writer.StartArray();
-      writer.String(message.c_str());
-      writer.EndArray();
+public:
+  /**
+   * @param[in, out] transport connection shared with the other callbacks
+   * @param[in] message_version version of the message format, 1, 2 or 3. Default is 1.
+   * @param[in] chain chain identifier, recorded in binary frames. Default is 0.
+   * @param[in] significant_digits significant digits of the values in draws. Default is 0, full precision.
+   */
+  explicit diagnostic_socket_writer(httpstan::transport &transport, int message_version = 1, unsigned int chain = 0,
+                                    int significant_digits = 0)
+      : socket_writer(transport, httpstan::channel::diagnostic_writer, message_version, chain, significant_digits) {}
 
-      writer.EndObject();
+  using socket_writer::operator();
 
-      send_message(buffer, socket);
+  /**
+   * Writes the column header or, after it, a sequence of names.
+   *
+   * @param[in] names Names in a std::vector
+   */
+  void operator()(const std::vector<std::string> &names) {
+    if (fields_.empty()) {
+      fields_ = names;
+      if (message_version_ >= 2)
+        send_fields("diagnostic", fields_);
       return;
-    } else if (message_prefix_ == "init_writer:") {
-      throw std::runtime_error("Unexpected string vector for init writer.");
-    } else if (message_prefix_ == "sample_writer:") {
-      // state machine dance here
-      if (processing_adaptation_state_ == ProcessingAdaptationState::BEFORE_PROCESSING_ADAPTATION) {
-        if (message.rfind("Adaptation terminated", 0) == 0) {
-          // message starts with "Adaptation terminated"
-          processing_adaptation_state_ = ProcessingAdaptationState::PROCESSING_ADAPTATION;
-        }
-      } else if (processing_adaptation_state_ == ProcessingAdaptationState::PROCESSING_ADAPTATION) {
-        if (message.rfind("Diagonal elements of inverse mass matrix", 0) == 0) {
-          // message starts with "Diagonal elements of inverse mass matrix"
-          // the next "message" (vector of doubles) will be the final adaptation message
-          processing_adaptation_state_ = ProcessingAdaptationState::FINAL_ADAPTATION_MESSAGE;
-        }
-      } else if (processing_adaptation_state_ == ProcessingAdaptationState::FINAL_ADAPTATION_MESSAGE) {
-        // this message is the last adaptation-related message before normal draws start arriving
-        processing_adaptation_state_ = ProcessingAdaptationState::AFTER_PROCESSING_ADAPTATION;
-      }
+    }
 
-      rapidjson::StringBuffer buffer;
-      rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-      writer.StartObject();
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    writer.StartObject();
 
-      writer.String("version");
-      writer.Int(1);
-      writer.String("topic");
-      writer.String("sample");
+    writer.String("version");
+    writer.Int(message_version_);
+    writer.String("topic");
+    writer.String("diagnostic");
 
-      writer.String("values");
-      writer.StartArray();
-      writer.String(message.c_str());
-      writer.EndArray();
+    writer.String("values");
+    writer.StartArray();
+    for (const std::string &name : names)
+      writer.String(name.c_str());
+    writer.EndArray();
 
-      writer.EndObject();
+    writer.EndObject();
 
-      send_message(buffer, socket);
-      return;
-    }
+    send_message(buffer);
+  }
+
+  /**
+   * Writes the diagnostics of a draw.
+   *
+   * @param[in] state Values in a std::vector
+   */
+  void operator()(const std::vector<double> &state) {
+    if (fields_.empty())
+      throw std::runtime_error("diagnostic fields must be set before receiving values");
+    send_draw("diagnostic", fields_, state);
   }
+
+  /**
+   * Writes a message.
+   *
+   * @param[in] message A string
+   */
+  void operator()(const std::string &message) { send_string("diagnostic", message); }
 };
 
 } // namespace callbacks
@@ -1,152 +1,379 @@
+#include <algorithm>
+#include <cstdint>
 #include <exception>
+#include <memory>
+#include <mutex>
 #include <ostream>
+#include <stdexcept>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <stan/callbacks/interrupt.hpp>
 #include <stan/callbacks/stream_logger.hpp>
 #include <stan/callbacks/writer.hpp>
 #include <stan/io/array_var_context.hpp>
 #include <stan/io/var_context.hpp>
+#include <stan/math/mix.hpp>
 #include <stan/model/model_base.hpp>
 #include <stan/services/sample/fixed_param.hpp>
 #include <stan/services/sample/hmc_nuts_diag_e_adapt.hpp>
 
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include "array_var_context_builder.hpp"
+#include "ess_interrupt.hpp"
+#include "json_var_context.hpp"
+#include "lru_cache.hpp"
+#include "npy_data.hpp"
 #include "socket_logger.hpp"
+#include "socket_transport.hpp"
 #include "socket_writer.hpp"
+#include "summary.hpp"
 
 namespace py = pybind11;
 
 // forward declaration for function defined in another translation unit
 stan::model::model_base &new_model(stan::io::var_context &data_context, unsigned int seed, std::ostream *msg_stream);
 
-// Returns a reference variable to a new array_var_context
+// Adds a NumPy array to ``builder``, reading values directly from the array's buffer.
 //
-// See the C++ documentation for ``array_var_context`` for details about the
-// C++ class.
-// Caller takes responsibility for deleting.
-stan::io::array_var_context &new_array_var_context(py::dict data) {
+// Returns false, leaving ``builder`` unchanged, if ``value`` is not a C- or
+// Fortran-contiguous array with dtype float64, int32 or int64.
+bool add_ndarray(httpstan::array_var_context_builder &builder, const std::string &name, py::handle value) {
+  if (!py::isinstance<py::array>(value))
+    return false;
+  py::array array = py::reinterpret_borrow<py::array>(value);
+  if (!(array.flags() & (py::array::c_style | py::array::f_style)))
+    return false;
+  bool column_major = array.flags() & py::array::f_style;
+  std::vector<size_t> dims(array.shape(), array.shape() + array.ndim());
+  if (py::isinstance<py::array_t<double>>(array))
+    builder.add_real(name, static_cast<const double *>(array.data()), dims, column_major);
+  else if (py::isinstance<py::array_t<std::int32_t>>(array))
+    builder.add_int(name, static_cast<const std::int32_t *>(array.data()), dims, column_major);
+  else if (py::isinstance<py::array_t<std::int64_t>>(array))
+    builder.add_int(name, static_cast<const std::int64_t *>(array.data()), dims, column_major);
+  else
+    return false;
+  return true;
+}
+
+// Returns the directory holding data files, empty if data files are not enabled.
+std::string data_directory() {
+  return py::module::import("httpstan.config").attr("HTTPSTAN_DATA_DIRECTORY").cast<std::string>();
+}
+
+// Add the values in ``data``, a dict, to ``builder``.
+//
+// NumPy arrays are read directly from their buffers. Strings refer to data
+// files (see ``httpstan::add_npy_data``). Other values (e.g., nested lists)
+// are converted by ``httpstan.utils._split_data``.
+void add_dict_data(httpstan::array_var_context_builder &builder, py::dict data) {
+  py::dict other_data;
+  for (auto item : data) {
+    std::string name = item.first.cast<std::string>();
+    if (py::isinstance<py::str>(item.second))
+      httpstan::add_npy_data(builder, name, item.second.cast<std::string>(), data_directory());
+    else if (!add_ndarray(builder, name, item.second))
+      other_data[item.first] = item.second;
+  }
+  if (other_data.size() == 0)
+    return;
+
   py::module utils = py::module::import("httpstan.utils");
-  py::tuple split_results = utils.attr("_split_data")(data);
+  py::tuple split_results = utils.attr("_split_data")(other_data);
 
-  std::vector<std::string> names_r;
   for (auto item : split_results[0])
-    names_r.push_back(item.cast<std::string>());
+    builder.names_r.push_back(item.cast<std::string>());
 
-  std::vector<double> values_r;
   for (auto item : split_results[1])
-    values_r.push_back(item.cast<double>());
+    builder.values_r.push_back(item.cast<double>());
 
-  std::vector<std::vector<size_t>> dim_r;
   for (auto lst : split_results[2]) {
     std::vector<size_t> dim;
     for (auto item : lst)
       dim.push_back(item.cast<size_t>());
-    dim_r.push_back(dim);
+    builder.dim_r.push_back(dim);
   }
 
-  std::vector<std::string> names_i;
   for (auto item : split_results[3])
-    names_i.push_back(item.cast<std::string>());
+    builder.names_i.push_back(item.cast<std::string>());
 
-  std::vector<int> values_i;
   for (auto item : split_results[4])
-    values_i.push_back(item.cast<int>());
+    builder.values_i.push_back(item.cast<int>());
 
-  std::vector<std::vector<size_t>> dim_i;
   for (auto lst : split_results[5]) {
     std::vector<size_t> dim;
     for (auto item : lst)
       dim.push_back(item.cast<size_t>());
-    dim_i.push_back(dim);
+    builder.dim_i.push_back(dim);
+  }
+}
+
+// Returns the cache of array_var_contexts built from JSON-encoded data.
+//
+// The capacity, in bytes, is read from ``httpstan.config`` when first called.
+httpstan::lru_cache<stan::io::array_var_context> &data_cache() {
+  static httpstan::lru_cache<stan::io::array_var_context> cache(
+      py::module::import("httpstan.config").attr("HTTPSTAN_DATA_CACHE_SIZE").cast<size_t>());
+  return cache;
+}
+
+// Returns the pool of models constructed from JSON-encoded data.
+//
+// Models are keyed by the hash of their data and their random seed. An
+// extension module holds a single Stan program, so the model name need not be
+// part of the key. Models do not change after construction and the model
+// methods called in this file are const, so threads may share a model.
+// The capacity, a number of models, is read from ``httpstan.config`` when first called.
+httpstan::lru_cache<stan::model::model_base> &model_pool() {
+  static httpstan::lru_cache<stan::model::model_base> pool(
+      py::module::import("httpstan.config").attr("HTTPSTAN_MODEL_POOL_SIZE").cast<size_t>());
+  return pool;
+}
+
+// Returns a hash of JSON-encoded data (bytes).
+//
+// Data may refer to data files by path, so the data directory and the
+// version of each file referred to (see ``httpstan::data_file_version``) are
+// part of the hash. Data referring to a file which has changed has a new hash.
+std::string data_digest(py::handle data) {
+  py::module hashlib = py::module::import("hashlib");
+  py::object hash = hashlib.attr("blake2b")(data, py::arg("digest_size") = 16);
+  std::string directory = data_directory();
+  if (!directory.empty()) {
+    hash.attr("update")(py::bytes(directory));
+    char *buffer;
+    Py_ssize_t length;
+    PYBIND11_BYTES_AS_STRING_AND_SIZE(data.ptr(), &buffer, &length);
+    std::string versions;
+    {
+      // ``data`` is immutable and outlives this scope
+      py::gil_scoped_release release;
+      for (const std::string &reference : httpstan::data_file_references(buffer, length)) {
+        versions.append(httpstan::data_file_version(directory, reference));
+        versions.push_back('\0');
+      }
+    }
+    hash.attr("update")(py::bytes(versions));
   }
+  return hash.attr("digest")().cast<std::string>();
+}
 
-  stan::io::array_var_context *var_context_ptr =
-      new stan::io::array_var_context(names_r, values_r, dim_r, names_i, values_i, dim_i);
-  return *var_context_ptr;
+// Returns a shared pointer to an array_var_context holding JSON-encoded ``data``.
+//
+// Contexts are cached, keyed by ``digest``, the hash of ``data`` and of the
+// versions of the data files it refers to, so requests repeating the same
+// data do not parse it again.
+std::shared_ptr<stan::io::array_var_context> json_var_context(py::handle data, const std::string &digest) {
+  std::shared_ptr<stan::io::array_var_context> var_context = data_cache().get(digest);
+  if (var_context)
+    return var_context;
+  httpstan::array_var_context_builder builder;
+  char *buffer;
+  Py_ssize_t length;
+  PYBIND11_BYTES_AS_STRING_AND_SIZE(data.ptr(), &buffer, &length);
+  std::string directory = data_directory();
+  {
+    // ``data`` is immutable and outlives this scope
+    py::gil_scoped_release release;
+    httpstan::add_json_data(buffer, length, builder, directory);
+    var_context.reset(builder.build());
+  }
+  data_cache().put(digest, var_context, builder.size_in_bytes());
+  return var_context;
+}
+
+// Returns a shared pointer to an array_var_context holding ``data``.
+//
+// See the C++ documentation for ``array_var_context`` for details about the
+// C++ class.
+// ``data`` is either a dict or a JSON-encoded object (bytes). JSON-encoded
+// data is parsed without creating any Python objects. Contexts built from
+// JSON-encoded data are cached.
+std::shared_ptr<stan::io::array_var_context> get_array_var_context(py::handle data) {
+  if (py::isinstance<py::bytes>(data))
+    return json_var_context(data, data_digest(data));
+  if (!py::isinstance<py::dict>(data))
+    throw py::type_error("Data must be a dict or a JSON-encoded object.");
+  httpstan::array_var_context_builder builder;
+  add_dict_data(builder, py::reinterpret_borrow<py::dict>(data));
+  return std::shared_ptr<stan::io::array_var_context>(builder.build());
+}
+
+// Returns a hash of the names, types, dimensions and values of the variables in ``var_context``.
+//
+// Variables are hashed in order of name, each as its type, name, dimensions
+// and values. Values are passed to the hash in chunks, without copying all of
+// them into one buffer. hashlib releases the GIL while it hashes each chunk.
+std::string var_context_digest(const stan::io::array_var_context &var_context) {
+  py::module hashlib = py::module::import("hashlib");
+  py::object hash = hashlib.attr("blake2b")(py::arg("digest_size") = 16);
+  py::object update = hash.attr("update");
+  auto update_bytes = [&update](const void *value, size_t size) {
+    update(py::memoryview::from_memory(value, static_cast<py::ssize_t>(size)));
+  };
+  auto update_variable = [&update_bytes](char type, const std::string &name, const std::vector<size_t> &dims) {
+    std::string header(1, type);
+    header.append(name);
+    header.push_back('\0');
+    auto append = [&header](uint64_t value) { header.append(reinterpret_cast<const char *>(&value), sizeof(value)); };
+    append(dims.size());
+    for (size_t dim : dims)
+      append(dim);
+    update_bytes(header.data(), header.size());
+  };
+  const size_t chunk_size = 1 << 16;  // values per call to ``update``
+  std::vector<std::string> names_r, names_i;
+  var_context.names_r(names_r);
+  var_context.names_i(names_i);
+  std::sort(names_r.begin(), names_r.end());
+  std::sort(names_i.begin(), names_i.end());
+  for (const std::string &name : names_r) {
+    update_variable('r', name, var_context.dims_r(name));
+    const std::vector<double> values = var_context.vals_r(name);
+    for (size_t begin = 0; begin < values.size(); begin += chunk_size)
+      update_bytes(values.data() + begin, sizeof(double) * std::min(chunk_size, values.size() - begin));
+  }
+  std::vector<int64_t> wide;
+  for (const std::string &name : names_i) {
+    update_variable('i', name, var_context.dims_i(name));
+    const std::vector<int> values = var_context.vals_i(name);
+    for (size_t begin = 0; begin < values.size(); begin += chunk_size) {
+      wide.assign(values.begin() + begin, values.begin() + std::min(begin + chunk_size, values.size()));
+      update_bytes(wide.data(), sizeof(int64_t) * wide.size());
+    }
+  }
+  return hash.attr("hexdigest")().cast<std::string>();
 }
 
 // See exported docstring
-std::string model_name() {
-  stan::io::array_var_context &var_context = new_array_var_context(py::dict()); // empty var_context
-  // random_seed, the second argument, is unused but the function requires it.
-  stan::model::model_base &model = new_model(var_context, (unsigned int)1, &std::cout);
-  std::string name = model.model_name();
+std::string canonical_data_digest(py::object data) { return var_context_digest(*get_array_var_context(data)); }
 
-  delete &model;
-  delete &var_context;
+// Returns a shared pointer to a model constructed with ``data`` and ``seed``.
+//
+// Constructing a model validates the data and runs the transformed data
+// block. The GIL is released meanwhile. Models constructed from JSON-encoded
+// data are kept in a pool and reused by later calls with the same data and seed.
+std::shared_ptr<stan::model::model_base> get_model(py::handle data, unsigned int seed) {
+  if (!py::isinstance<py::bytes>(data)) {
+    std::shared_ptr<stan::io::array_var_context> var_context = get_array_var_context(data);
+    py::gil_scoped_release release;
+    return std::shared_ptr<stan::model::model_base>(&new_model(*var_context, seed, &std::cout));
+  }
+  std::string digest = data_digest(data);
+  std::string key = digest + ":" + std::to_string(seed);
+  std::shared_ptr<stan::model::model_base> model = model_pool().get(key);
+  if (model)
+    return model;
+  std::shared_ptr<stan::io::array_var_context> var_context = json_var_context(data, digest);
+  {
+    py::gil_scoped_release release;
+    model.reset(&new_model(*var_context, seed, &std::cout));
+  }
+  model_pool().put(key, model, 1);
+  return model;
+}
+
+// See exported docstring
+std::string model_name() {
+  // The seed, the second argument, is unused but new_model requires it.
+  std::shared_ptr<stan::model::model_base> model = get_model(py::dict(), 1); // empty var_context
+  std::string name = model->model_name();
 
   return name;
 }
 
 // See exported docstring
-std::vector<std::string> get_param_names(py::dict data) {
+std::vector<std::string> get_param_names(py::object data) {
   std::vector<std::string> names;
-  stan::io::array_var_context &var_context = new_array_var_context(data);
-  // random_seed, the second argument, is unused but the function requires it.
-  stan::model::model_base &model = new_model(var_context, (unsigned int)1, &std::cout);
-  model.get_param_names(names);
-
-  delete &model;
-  delete &var_context;
+  // The seed, the second argument, is unused but new_model requires it.
+  std::shared_ptr<stan::model::model_base> model = get_model(data, 1);
+  model->get_param_names(names);
 
   return names;
 }
 
 // See exported docstring
-std::vector<std::string> constrained_param_names(py::dict data) {
-  stan::io::array_var_context &var_context = new_array_var_context(data);
+std::vector<std::string> constrained_param_names(py::object data) {
   std::vector<std::string> names;
-  // random_seed, the second argument, is unused but the function requires it.
-  stan::model::model_base &model = new_model(var_context, (unsigned int)1, &std::cout);
-  model.constrained_param_names(names);
-
-  delete &model;
-  delete &var_context;
+  // The seed, the second argument, is unused but new_model requires it.
+  std::shared_ptr<stan::model::model_base> model = get_model(data, 1);
+  model->constrained_param_names(names);
 
   return names;
 }
 
 // See exported docstring
-std::vector<std::vector<size_t>> get_dims(py::dict data) {
-  stan::io::array_var_context &var_context = new_array_var_context(data);
+std::vector<std::vector<size_t>> get_dims(py::object data) {
   std::vector<std::vector<size_t>> dims_;
-  // random_seed, the second argument, is unused but the function requires it.
-  stan::model::model_base &model = new_model(var_context, (unsigned int)1, &std::cout);
-  model.get_dims(dims_);
-
-  delete &model;
-  delete &var_context;
+  // The seed, the second argument, is unused but new_model requires it.
+  std::shared_ptr<stan::model::model_base> model = get_model(data, 1);
+  model->get_dims(dims_);
 
   return dims_;
 }
 
-// See exported docstring
-double log_prob(py::dict data, const std::vector<double> &unconstrained_parameters, bool adjust_transform) {
-  double lp;
-  stan::io::array_var_context &var_context = new_array_var_context(data);
-  // random_seed, the second argument, is unused but the function requires it.
-  stan::model::model_base &model = new_model(var_context, (unsigned int)1, &std::cout);
-  if (unconstrained_parameters.size() != model.num_params_r()) {
+// Parameters: a vector or, for the batched functions, a matrix with one vector
+// per row. Lists and NumPy arrays are accepted; contiguous float64 arrays are
+// read without a copy. The shape is checked by ``check_parameter_vector`` or
+// ``check_parameter_matrix``.
+typedef py::array_t<double, py::array::c_style | py::array::forcecast> parameter_array;
+
+// Check that ``unconstrained_parameters`` is a vector with one element per unconstrained parameter of ``model``.
+void check_parameter_vector(const stan::model::model_base &model, const parameter_array &unconstrained_parameters) {
+  if (unconstrained_parameters.ndim() != 1)
+    throw std::runtime_error("Unconstrained parameters must be a one-dimensional array.");
+  if (static_cast<size_t>(unconstrained_parameters.size()) != model.num_params_r()) {
     throw std::runtime_error(
         "The number of parameters does not match the number of unconstrained parameters in the model.");
   }
+}
+
+// Check that ``unconstrained_parameters`` is a matrix with one column per unconstrained parameter of ``model``.
+void check_parameter_matrix(const stan::model::model_base &model, const parameter_array &unconstrained_parameters) {
+  if (unconstrained_parameters.ndim() != 2)
+    throw std::runtime_error("Unconstrained parameters must be a two-dimensional array, one row per point.");
+  if (static_cast<size_t>(unconstrained_parameters.shape(1)) != model.num_params_r()) {
+    throw std::runtime_error(
+        "The number of parameters does not match the number of unconstrained parameters in the model.");
+  }
+}
+
+// Returns a NumPy array holding a copy of ``values``.
+py::array_t<double> to_ndarray(const std::vector<double> &values) {
+  return py::array_t<double>(values.size(), values.data());
+}
+
+// See exported docstring
+double log_prob(py::object data, parameter_array unconstrained_parameters, bool adjust_transform) {
+  double lp;
+  // The seed, the second argument, is unused but new_model requires it.
+  std::shared_ptr<stan::model::model_base> model = get_model(data, 1);
+  check_parameter_vector(*model, unconstrained_parameters);
+  py::gil_scoped_release release;
+  // Calls may come from any thread. Each thread needs its own AD tape.
+  stan::math::ChainableStack ad_tape;
   std::vector<stan::math::var> ad_params_r;
-  ad_params_r.reserve(model.num_params_r());
-  for (size_t i = 0; i < model.num_params_r(); i++) {
-    ad_params_r.push_back(unconstrained_parameters[i]);
+  ad_params_r.reserve(model->num_params_r());
+  for (size_t i = 0; i < model->num_params_r(); i++) {
+    ad_params_r.push_back(unconstrained_parameters.data()[i]);
   }
   // calculate logprob
-  std::vector<int> params_i(model.num_params_i(), 0);
+  std::vector<int> params_i(model->num_params_i(), 0);
   std::exception_ptr p;
   try {
     // params_i, the second argument, is unused but the function requires it (see model_base.hpp).
     if (adjust_transform) {
-      lp = model.template log_prob<true, true>(ad_params_r, params_i, &std::cout).val();
+      lp = model->template log_prob<true, true>(ad_params_r, params_i, &std::cout).val();
     } else {
-      lp = model.template log_prob<true, false>(ad_params_r, params_i, &std::cout).val();
+      lp = model->template log_prob<true, false>(ad_params_r, params_i, &std::cout).val();
     }
     stan::math::recover_memory();
   } catch (std::exception &ex) {
@@ -154,9 +381,6 @@ double log_prob(py::dict data, const std::vector<double> &unconstrained_paramete
     p = std::current_exception();
   }
 
-  delete &model;
-  delete &var_context;
-
   if (p)
     std::rethrow_exception(p);
 
@@ -164,137 +388,391 @@ double log_prob(py::dict data, const std::vector<double> &unconstrained_paramete
 }
 
 // See exported docstring
-std::vector<double> log_prob_grad(py::dict data, const std::vector<double> &unconstrained_parameters,
-                                  bool adjust_transform) {
+py::array_t<double> log_prob_grad(py::object data, parameter_array unconstrained_parameters, bool adjust_transform) {
   std::vector<double> gradient;
-  stan::io::array_var_context &var_context = new_array_var_context(data);
-  // random_seed, the second argument, is unused but the function requires it.
-  stan::model::model_base &model = new_model(var_context, (unsigned int)1, &std::cout);
-  if (unconstrained_parameters.size() != model.num_params_r()) {
-    throw std::runtime_error(
-        "The number of parameters does not match the number of unconstrained parameters in the model.");
-  }
-  // The params_r parameter is incorrectly declared as non-const in Stan C++.
-  // Unconstrained_parameters are cast from const to non-const below, as required by Stan (see model_base.hpp).
-  std::vector<double> &params_r = const_cast<std::vector<double> &>(unconstrained_parameters);
+  // The seed, the second argument, is unused but new_model requires it.
+  std::shared_ptr<stan::model::model_base> model = get_model(data, 1);
+  check_parameter_vector(*model, unconstrained_parameters);
+  // The params_r parameter is incorrectly declared as non-const in Stan C++, so parameters are copied.
+  std::vector<double> params_r(unconstrained_parameters.data(),
+                               unconstrained_parameters.data() + unconstrained_parameters.size());
   // calculate gradient
   std::exception_ptr p;
-  std::vector<int> params_i(model.num_params_i(), 0);
-  try {
-    // params_i, the third argument, is unused but the function requires it (see model_base.hpp).
-    if (adjust_transform) {
-      stan::model::log_prob_grad<true, true>(model, params_r, params_i, gradient, &std::cout);
-    } else {
-      stan::model::log_prob_grad<true, false>(model, params_r, params_i, gradient, &std::cout);
+  std::vector<int> params_i(model->num_params_i(), 0);
+  {
+    py::gil_scoped_release release;
+    // Calls may come from any thread. Each thread needs its own AD tape.
+    stan::math::ChainableStack ad_tape;
+    try {
+      // params_i, the third argument, is unused but the function requires it (see model_base.hpp).
+      if (adjust_transform) {
+        stan::model::log_prob_grad<true, true>(*model, params_r, params_i, gradient, &std::cout);
+      } else {
+        stan::model::log_prob_grad<true, false>(*model, params_r, params_i, gradient, &std::cout);
+      }
+    } catch (std::exception &ex) {
+      p = std::current_exception();
     }
-  } catch (std::exception &ex) {
-    p = std::current_exception();
   }
 
-  delete &model;
-  delete &var_context;
+  if (p)
+    std::rethrow_exception(p);
+
+  return to_ndarray(gradient);
+}
+
+// See exported docstring
+py::array_t<double> log_prob_batch(py::object data, parameter_array unconstrained_parameters,
+                                   bool adjust_transform) {
+  // The seed, the second argument, is unused but new_model requires it.
+  std::shared_ptr<stan::model::model_base> model = get_model(data, 1);
+  check_parameter_matrix(*model, unconstrained_parameters);
+  const size_t num_points = unconstrained_parameters.shape(0);
+  const size_t num_params = unconstrained_parameters.shape(1);
+  const double *params = unconstrained_parameters.data();
+  py::array_t<double> log_probs(num_points);
+  double *lp = log_probs.mutable_data();
+
+  // The first exception thrown by any point is rethrown once all points are done.
+  std::exception_ptr p;
+  std::mutex p_mutex;
+  {
+    py::gil_scoped_release release;
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, num_points), [&](const tbb::blocked_range<size_t> &range) {
+      // Each thread records operations on its own AD tape.
+      stan::math::ChainableStack ad_tape;
+      std::vector<stan::math::var> ad_params_r(num_params);
+      std::vector<int> params_i(model->num_params_i(), 0);
+      for (size_t n = range.begin(); n != range.end(); ++n) {
+        try {
+          for (size_t i = 0; i < num_params; i++)
+            ad_params_r[i] = params[n * num_params + i];
+          // params_i, the second argument, is unused but the function requires it (see model_base.hpp).
+          if (adjust_transform) {
+            lp[n] = model->template log_prob<true, true>(ad_params_r, params_i, &std::cout).val();
+          } else {
+            lp[n] = model->template log_prob<true, false>(ad_params_r, params_i, &std::cout).val();
+          }
+        } catch (std::exception &ex) {
+          std::lock_guard<std::mutex> lock(p_mutex);
+          if (!p)
+            p = std::current_exception();
+        }
+        stan::math::recover_memory();
+      }
+    });
+  }
 
   if (p)
     std::rethrow_exception(p);
 
-  return gradient;
+  return log_probs;
 }
 
 // See exported docstring
-std::vector<double> write_array(py::dict data, const std::vector<double> &unconstrained_parameters,
+py::tuple log_prob_grad_batch(py::object data, parameter_array unconstrained_parameters, bool adjust_transform) {
+  // The seed, the second argument, is unused but new_model requires it.
+  std::shared_ptr<stan::model::model_base> model = get_model(data, 1);
+  check_parameter_matrix(*model, unconstrained_parameters);
+  const size_t num_points = unconstrained_parameters.shape(0);
+  const size_t num_params = unconstrained_parameters.shape(1);
+  const double *params = unconstrained_parameters.data();
+  py::array_t<double> log_probs(num_points);
+  py::array_t<double> gradients({num_points, num_params});
+  double *lp = log_probs.mutable_data();
+  double *grad = gradients.mutable_data();
+
+  // The first exception thrown by any point is rethrown once all points are done.
+  std::exception_ptr p;
+  std::mutex p_mutex;
+  {
+    py::gil_scoped_release release;
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, num_points), [&](const tbb::blocked_range<size_t> &range) {
+      // Each thread records operations on its own AD tape.
+      stan::math::ChainableStack ad_tape;
+      std::vector<double> params_r(num_params);
+      std::vector<double> gradient;
+      std::vector<int> params_i(model->num_params_i(), 0);
+      for (size_t n = range.begin(); n != range.end(); ++n) {
+        std::copy(params + n * num_params, params + (n + 1) * num_params, params_r.begin());
+        try {
+          // params_i, the third argument, is unused but the function requires it (see model_base.hpp).
+          if (adjust_transform) {
+            lp[n] = stan::model::log_prob_grad<true, true>(*model, params_r, params_i, gradient, &std::cout);
+          } else {
+            lp[n] = stan::model::log_prob_grad<true, false>(*model, params_r, params_i, gradient, &std::cout);
+          }
+          std::copy(gradient.begin(), gradient.end(), grad + n * num_params);
+        } catch (std::exception &ex) {
+          std::lock_guard<std::mutex> lock(p_mutex);
+          if (!p)
+            p = std::current_exception();
+        }
+      }
+    });
+  }
+
+  if (p)
+    std::rethrow_exception(p);
+
+  return py::make_tuple(log_probs, gradients);
+}
+
+// Functor calling the ``log_prob`` method of a model, for use with Stan Math autodiff functionals.
+template <bool jacobian>
+class log_prob_functor {
+  const stan::model::model_base &model_;
+  std::ostream *msgs_;
+
+public:
+  log_prob_functor(const stan::model::model_base &model, std::ostream *msgs) : model_(model), msgs_(msgs) {}
+
+  template <typename T>
+  T operator()(const Eigen::Matrix<T, Eigen::Dynamic, 1> &x) const {
+    // The params_r parameter is incorrectly declared as non-const in Stan C++.
+    Eigen::Matrix<T, Eigen::Dynamic, 1> params_r = x;
+    return model_.template log_prob<true, jacobian>(params_r, msgs_);
+  }
+};
+
+// See exported docstring
+py::tuple hessian(py::object data, parameter_array unconstrained_parameters, bool adjust_transform) {
+  // The seed, the second argument, is unused but new_model requires it.
+  std::shared_ptr<stan::model::model_base> model = get_model(data, 1);
+  check_parameter_vector(*model, unconstrained_parameters);
+  Eigen::VectorXd x = Eigen::Map<const Eigen::VectorXd>(unconstrained_parameters.data(), model->num_params_r());
+  double lp;
+  Eigen::VectorXd gradient;
+  Eigen::MatrixXd hessian;
+  std::exception_ptr p;
+  {
+    py::gil_scoped_release release;
+    // Calls may come from any thread. Each thread needs its own AD tape.
+    stan::math::ChainableStack ad_tape;
+    try {
+      // forward-over-reverse autodiff
+      if (adjust_transform) {
+        stan::math::hessian(log_prob_functor<true>(*model, &std::cout), x, lp, gradient, hessian);
+      } else {
+        stan::math::hessian(log_prob_functor<false>(*model, &std::cout), x, lp, gradient, hessian);
+      }
+    } catch (std::exception &ex) {
+      p = std::current_exception();
+    }
+  }
+
+  if (p)
+    std::rethrow_exception(p);
+
+  const size_t num_params = x.size();
+  py::array_t<double> hessian_array({num_params, num_params});
+  // copy into a row-major array
+  Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(
+      hessian_array.mutable_data(), num_params, num_params) = hessian;
+  return py::make_tuple(lp, py::array_t<double>(num_params, gradient.data()), hessian_array);
+}
+
+// See exported docstring
+py::tuple hessian_vector_product(py::object data, parameter_array unconstrained_parameters, parameter_array vector,
+                                 bool adjust_transform) {
+  // The seed, the second argument, is unused but new_model requires it.
+  std::shared_ptr<stan::model::model_base> model = get_model(data, 1);
+  check_parameter_vector(*model, unconstrained_parameters);
+  if (vector.ndim() != 1 || static_cast<size_t>(vector.size()) != model->num_params_r())
+    throw std::runtime_error("The vector must have one element per unconstrained parameter in the model.");
+  Eigen::VectorXd x = Eigen::Map<const Eigen::VectorXd>(unconstrained_parameters.data(), model->num_params_r());
+  Eigen::VectorXd v = Eigen::Map<const Eigen::VectorXd>(vector.data(), model->num_params_r());
+  double lp;
+  Eigen::VectorXd product;
+  std::exception_ptr p;
+  {
+    py::gil_scoped_release release;
+    // Calls may come from any thread. Each thread needs its own AD tape.
+    stan::math::ChainableStack ad_tape;
+    try {
+      // forward-over-reverse autodiff, without forming the Hessian
+      if (adjust_transform) {
+        stan::math::hessian_times_vector(log_prob_functor<true>(*model, &std::cout), x, v, lp, product);
+      } else {
+        stan::math::hessian_times_vector(log_prob_functor<false>(*model, &std::cout), x, v, lp, product);
+      }
+    } catch (std::exception &ex) {
+      p = std::current_exception();
+    }
+  }
+
+  if (p)
+    std::rethrow_exception(p);
+
+  return py::make_tuple(lp, py::array_t<double>(product.size(), product.data()));
+}
+
+// See exported docstring
+py::array_t<double> write_array(py::object data, parameter_array unconstrained_parameters,
                                 bool include_tparams = true, bool include_gqs = true) {
   boost::ecuyer1988 base_rng(0);
   std::vector<double> params_r_constrained;
-  stan::io::array_var_context &var_context = new_array_var_context(data);
-  // random_seed, the second argument, is unused but the function requires it.
-  stan::model::model_base &model = new_model(var_context, (unsigned int)1, &std::cout);
-  if (unconstrained_parameters.size() != model.num_params_r()) {
-    throw std::runtime_error(
-        "The number of parameters does not match the number of unconstrained parameters in the model.");
-  }
-  // The params_r parameter is incorrectly declared as non-const in Stan C++.
-  // Unconstrained_parameters are cast from const to non-const below, as required by Stan (see model_base.hpp).
-  std::vector<double> &params_r = const_cast<std::vector<double> &>(unconstrained_parameters);
+  // The seed, the second argument, is unused but new_model requires it.
+  std::shared_ptr<stan::model::model_base> model = get_model(data, 1);
+  check_parameter_vector(*model, unconstrained_parameters);
+  // The params_r parameter is incorrectly declared as non-const in Stan C++, so parameters are copied.
+  std::vector<double> params_r(unconstrained_parameters.data(),
+                               unconstrained_parameters.data() + unconstrained_parameters.size());
   // constrain parameters to their defined support
   std::exception_ptr p;
-  std::vector<int> params_i(model.num_params_i(), 0);
-  try {
-    // params_i, the third argument, is unused but the function requires it (see model_base.hpp).
-    model.write_array(base_rng, params_r, params_i, params_r_constrained, include_tparams, include_gqs, &std::cout);
-  } catch (std::exception &ex) {
-    p = std::current_exception();
+  std::vector<int> params_i(model->num_params_i(), 0);
+  {
+    py::gil_scoped_release release;
+    try {
+      // params_i, the third argument, is unused but the function requires it (see model_base.hpp).
+      model->write_array(base_rng, params_r, params_i, params_r_constrained, include_tparams, include_gqs,
+                         &std::cout);
+    } catch (std::exception &ex) {
+      p = std::current_exception();
+    }
   }
 
-  delete &model;
-  delete &var_context;
-
   if (p)
     std::rethrow_exception(p);
 
-  return params_r_constrained;
+  return to_ndarray(params_r_constrained);
 }
 
 // See exported docstring
-std::vector<double> transform_inits(py::dict data, py::dict constrained_parameters) {
+py::array_t<double> transform_inits(py::object data, py::object constrained_parameters) {
   std::vector<double> params_r_unconstrained;
-  stan::io::array_var_context &var_context = new_array_var_context(data);
-  // random_seed, the second argument, is unused but the function requires it.
-  stan::model::model_base &model = new_model(var_context, (unsigned int)1, &std::cout);
-  stan::io::var_context &param_var_context = new_array_var_context(constrained_parameters);
+  // The seed, the second argument, is unused but new_model requires it.
+  std::shared_ptr<stan::model::model_base> model = get_model(data, 1);
+  std::shared_ptr<stan::io::array_var_context> param_var_context = get_array_var_context(constrained_parameters);
   // unconstrain parameters from their defined support
   std::exception_ptr p;
-  std::vector<int> params_i(model.num_params_i(), 0);
-  try {
-    // params_i, the second argument, is unused but the function requires it (see model_base.hpp).
-    model.transform_inits(param_var_context, params_i, params_r_unconstrained, &std::cout);
-  } catch (std::exception &ex) {
-    p = std::current_exception();
+  std::vector<int> params_i(model->num_params_i(), 0);
+  {
+    py::gil_scoped_release release;
+    try {
+      // params_i, the second argument, is unused but the function requires it (see model_base.hpp).
+      model->transform_inits(*param_var_context, params_i, params_r_unconstrained, &std::cout);
+    } catch (std::exception &ex) {
+      p = std::current_exception();
+    }
   }
 
-  delete &model;
-  delete &var_context;
-  delete &param_var_context;
-
   if (p)
     std::rethrow_exception(p);
 
-  return params_r_unconstrained;
+  return to_ndarray(params_r_unconstrained);
+}
+
+// Returns an interrupt which ends sampling once the effective sample size of the columns of ``writer`` matching
+// ``target_ess_parameters`` reaches ``target_ess`` or, if ``target_ess`` is 0, an interrupt which does nothing.
+std::unique_ptr<stan::callbacks::interrupt> make_interrupt(const stan::callbacks::sample_socket_writer &writer,
+                                                           double target_ess,
+                                                           const std::vector<std::string> &target_ess_parameters,
+                                                           bool after_adaptation) {
+  if (target_ess > 0)
+    return std::unique_ptr<stan::callbacks::interrupt>(
+        new stan::callbacks::ess_interrupt(writer, target_ess, target_ess_parameters, after_adaptation));
+  return std::unique_ptr<stan::callbacks::interrupt>(new stan::callbacks::interrupt());
+}
+
+// Returns the JSON object stored in the sketch of a fit (see ``httpstan::summary::to_wire``): the name of the
+// ``function``, a digest of the ``data`` and the ``arguments`` which fits must share to be merged. The seed, chain,
+// initial values and number of draws may differ between the fits of a model which are merged.
+std::string describe_fit(const std::string &function, const stan::io::array_var_context &data,
+                         const std::vector<std::pair<std::string, double>> &arguments) {
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+  writer.StartObject();
+  writer.String("function");
+  writer.String(function.c_str());
+  writer.String("data");
+  writer.String(var_context_digest(data).c_str());
+  writer.String("arguments");
+  writer.StartObject();
+  for (const std::pair<std::string, double> &argument : arguments) {
+    writer.String(argument.first.c_str());
+    writer.Double(argument.second);
+  }
+  writer.EndObject();
+  writer.EndObject();
+  return std::string(buffer.GetString(), buffer.GetSize());
 }
 
 // See exported docstring
-int hmc_nuts_diag_e_adapt_wrapper(std::string socket_filename, py::dict data, py::dict init, int random_seed,
-                                  int chain, double init_radius, int num_warmup, int num_samples, int num_thin,
-                                  bool save_warmup, int refresh, double stepsize, double stepsize_jitter,
-                                  int max_depth, double delta, double gamma, double kappa, double t0, int init_buffer,
-                                  int term_buffer, int window) {
+int hmc_nuts_diag_e_adapt_wrapper(std::string socket_filename, std::string fit_filename, py::object data,
+                                  py::object init, int random_seed, int chain, double init_radius, int num_warmup,
+                                  int num_samples, int num_thin, bool save_warmup, int refresh, double stepsize,
+                                  double stepsize_jitter, int max_depth, double delta, double gamma, double kappa,
+                                  double t0, int init_buffer, int term_buffer, int window, int message_version,
+                                  int significant_digits, std::vector<std::string> include,
+                                  std::vector<std::string> exclude, double target_ess,
+                                  std::vector<std::string> target_ess_parameters) {
   int return_code;
-  stan::io::array_var_context &var_context = new_array_var_context(data);
-  stan::model::model_base &model = new_model(var_context, (unsigned int)random_seed, &std::cout);
-  stan::io::array_var_context &init_var_context = new_array_var_context(init);
-  stan::callbacks::interrupt interrupt;
-  stan::callbacks::logger *logger = new stan::callbacks::socket_logger(socket_filename, "logger:");
-  stan::callbacks::writer *init_writer = new stan::callbacks::socket_writer(socket_filename, "init_writer:");
-  stan::callbacks::writer *sample_writer = new stan::callbacks::socket_writer(socket_filename, "sample_writer:");
-  stan::callbacks::writer *diagnostic_writer =
-      new stan::callbacks::socket_writer(socket_filename, "diagnostic_writer:");
+  std::shared_ptr<stan::io::array_var_context> var_context = get_array_var_context(data);
+  stan::model::model_base &model = new_model(*var_context, (unsigned int)random_seed, &std::cout);
+  std::shared_ptr<stan::io::array_var_context> init_var_context = get_array_var_context(init);
+  const std::string fit = describe_fit("hmc_nuts_diag_e_adapt", *var_context,
+                                       {{"init_radius", init_radius},
+                                        {"num_warmup", num_warmup},
+                                        {"num_thin", num_thin},
+                                        {"save_warmup", save_warmup},
+                                        {"stepsize", stepsize},
+                                        {"stepsize_jitter", stepsize_jitter},
+                                        {"max_depth", max_depth},
+                                        {"delta", delta},
+                                        {"gamma", gamma},
+                                        {"kappa", kappa},
+                                        {"t0", t0},
+                                        {"init_buffer", init_buffer},
+                                        {"term_buffer", term_buffer},
+                                        {"window", window}});
+  // the logger and the writers share one transport, which is closed after they are deleted
+  httpstan::socket_transport transport(socket_filename, fit_filename);
+  stan::callbacks::logger *logger = new stan::callbacks::socket_logger(transport);
+  stan::callbacks::writer *init_writer = new stan::callbacks::init_socket_writer(transport);
+  stan::callbacks::sample_socket_writer *sample_writer =
+      new stan::callbacks::sample_socket_writer(transport, message_version, chain, significant_digits, include,
+                                                exclude);
+  stan::callbacks::diagnostic_socket_writer *diagnostic_writer =
+      new stan::callbacks::diagnostic_socket_writer(transport, message_version, chain, significant_digits);
+  std::unique_ptr<stan::callbacks::interrupt> interrupt =
+      make_interrupt(*sample_writer, target_ess, target_ess_parameters, true);
+  bool truncated = false;
   std::exception_ptr p;
   py::gil_scoped_release release;
   try {
-    return_code = stan::services::sample::hmc_nuts_diag_e_adapt(
-        model, init_var_context, random_seed, chain, init_radius, num_warmup, num_samples, num_thin, save_warmup,
-        refresh, stepsize, stepsize_jitter, max_depth, delta, gamma, kappa, t0, init_buffer, term_buffer, window,
-        interrupt, *logger, *init_writer, *sample_writer, *diagnostic_writer);
+    try {
+      return_code = stan::services::sample::hmc_nuts_diag_e_adapt(
+          model, *init_var_context, random_seed, chain, init_radius, num_warmup, num_samples, num_thin, save_warmup,
+          refresh, stepsize, stepsize_jitter, max_depth, delta, gamma, kappa, t0, init_buffer, term_buffer, window,
+          *interrupt, *logger, *init_writer, *sample_writer, *diagnostic_writer);
+    } catch (const httpstan::sampling_stopped &e) {
+      // sampling ended early, the draws written so far are the fit
+      logger->info(e.what());
+      return_code = stan::services::error_codes::OK;
+      truncated = true;
+    }
+    sample_writer->flush_draws();
+    diagnostic_writer->flush_draws();
+    transport.add_sidecar(".summary.json", sample_writer->summary().to_json(truncated));
+    transport.add_sidecar(".sketch", sample_writer->summary().to_wire(fit));
   } catch (const std::exception &e) {
     p = std::current_exception();
   }
 
   delete &model;
-  delete &init_var_context;
   delete logger;
   delete init_writer;
   delete sample_writer;
   delete diagnostic_writer;
-  delete &var_context;
+
+  // the fit is committed here, rather than when the transport is destroyed, so errors are reported
+  try {
+    transport.finish();
+  } catch (const std::exception &e) {
+    if (!p)
+      p = std::current_exception();
+  }
 
   if (p)
     std::rethrow_exception(p);
@@ -303,35 +781,63 @@ int hmc_nuts_diag_e_adapt_wrapper(std::string socket_filename, py::dict data, py
 }
 
 // See exported docstring
-int fixed_param_wrapper(std::string socket_filename, py::dict data, py::dict init, int random_seed, int chain,
-                        double init_radius, int num_samples, int num_thin, int refresh) {
+int fixed_param_wrapper(std::string socket_filename, std::string fit_filename, py::object data, py::object init,
+                        int random_seed, int chain, double init_radius, int num_samples, int num_thin, int refresh,
+                        int message_version, int significant_digits, std::vector<std::string> include,
+                        std::vector<std::string> exclude, double target_ess,
+                        std::vector<std::string> target_ess_parameters) {
   int return_code;
-  stan::io::array_var_context &var_context = new_array_var_context(data);
-  stan::model::model_base &model = new_model(var_context, (unsigned int)random_seed, &std::cout);
-  stan::io::array_var_context &init_var_context = new_array_var_context(init);
-  stan::callbacks::interrupt interrupt;
-  stan::callbacks::logger *logger = new stan::callbacks::socket_logger(socket_filename, "logger:");
-  stan::callbacks::writer *init_writer = new stan::callbacks::socket_writer(socket_filename, "init_writer:");
-  stan::callbacks::writer *sample_writer = new stan::callbacks::socket_writer(socket_filename, "sample_writer:");
-  stan::callbacks::writer *diagnostic_writer =
-      new stan::callbacks::socket_writer(socket_filename, "diagnostic_writer:");
+  std::shared_ptr<stan::io::array_var_context> var_context = get_array_var_context(data);
+  stan::model::model_base &model = new_model(*var_context, (unsigned int)random_seed, &std::cout);
+  std::shared_ptr<stan::io::array_var_context> init_var_context = get_array_var_context(init);
+  const std::string fit =
+      describe_fit("fixed_param", *var_context, {{"init_radius", init_radius}, {"num_thin", num_thin}});
+  // the logger and the writers share one transport, which is closed after they are deleted
+  httpstan::socket_transport transport(socket_filename, fit_filename);
+  stan::callbacks::logger *logger = new stan::callbacks::socket_logger(transport);
+  stan::callbacks::writer *init_writer = new stan::callbacks::init_socket_writer(transport);
+  stan::callbacks::sample_socket_writer *sample_writer =
+      new stan::callbacks::sample_socket_writer(transport, message_version, chain, significant_digits, include,
+                                                exclude);
+  stan::callbacks::diagnostic_socket_writer *diagnostic_writer =
+      new stan::callbacks::diagnostic_socket_writer(transport, message_version, chain, significant_digits);
+  std::unique_ptr<stan::callbacks::interrupt> interrupt =
+      make_interrupt(*sample_writer, target_ess, target_ess_parameters, false);
+  bool truncated = false;
   std::exception_ptr p;
   py::gil_scoped_release release;
   try {
-    return_code = stan::services::sample::fixed_param(model, init_var_context, random_seed, chain, init_radius,
-                                                      num_samples, num_thin, refresh, interrupt, *logger, *init_writer,
-                                                      *sample_writer, *diagnostic_writer);
+    try {
+      return_code = stan::services::sample::fixed_param(model, *init_var_context, random_seed, chain, init_radius,
+                                                        num_samples, num_thin, refresh, *interrupt, *logger,
+                                                        *init_writer, *sample_writer, *diagnostic_writer);
+    } catch (const httpstan::sampling_stopped &e) {
+      // sampling ended early, the draws written so far are the fit
+      logger->info(e.what());
+      return_code = stan::services::error_codes::OK;
+      truncated = true;
+    }
+    sample_writer->flush_draws();
+    diagnostic_writer->flush_draws();
+    transport.add_sidecar(".summary.json", sample_writer->summary().to_json(truncated));
+    transport.add_sidecar(".sketch", sample_writer->summary().to_wire(fit));
   } catch (const std::exception &e) {
     p = std::current_exception();
   }
 
   delete &model;
-  delete &init_var_context;
   delete logger;
   delete init_writer;
   delete sample_writer;
   delete diagnostic_writer;
-  delete &var_context;
+
+  // the fit is committed here, rather than when the transport is destroyed, so errors are reported
+  try {
+    transport.finish();
+  } catch (const std::exception &e) {
+    if (!p)
+      p = std::current_exception();
+  }
 
   if (p)
     std::rethrow_exception(p);
@@ -339,6 +845,56 @@ int fixed_param_wrapper(std::string socket_filename, py::dict data, py::dict ini
   return return_code;
 }
 
+// See exported docstring
+py::tuple split_json_request(py::bytes body, const std::vector<std::string> &keys) {
+  char *buffer;
+  Py_ssize_t length;
+  PYBIND11_BYTES_AS_STRING_AND_SIZE(body.ptr(), &buffer, &length);
+  std::vector<httpstan::json_member> members = httpstan::find_data_members(buffer, length, keys);
+
+  py::dict data;
+  std::string remainder;
+  size_t position = 0;
+  for (const httpstan::json_member &member : members) {
+    data[py::str(member.name)] = py::bytes(buffer + member.begin, member.end - member.begin);
+    remainder.append(buffer + position, member.begin - position);
+    remainder.append("{}");
+    position = member.end;
+  }
+  remainder.append(buffer + position, length - position);
+  return py::make_tuple(data, py::bytes(remainder));
+}
+
+// Returns statistics about ``cache`` as a dict.
+template <typename T>
+py::dict lru_cache_info(const httpstan::lru_cache<T> &cache) {
+  py::dict info;
+  info["hits"] = cache.hits();
+  info["misses"] = cache.misses();
+  info["entries"] = cache.entries();
+  info["size"] = cache.size();
+  info["capacity"] = cache.capacity();
+  return info;
+}
+
+// See exported docstring
+py::dict data_cache_info() { return lru_cache_info(data_cache()); }
+
+// See exported docstring
+void set_data_cache_capacity(size_t capacity) { data_cache().set_capacity(capacity); }
+
+// See exported docstring
+void clear_data_cache() { data_cache().clear(); }
+
+// See exported docstring
+py::dict model_pool_info() { return lru_cache_info(model_pool()); }
+
+// See exported docstring
+void set_model_pool_capacity(size_t capacity) { model_pool().set_capacity(capacity); }
+
+// See exported docstring
+void clear_model_pool() { model_pool().clear(); }
+
 PYBIND11_MODULE(stan_services, m) {
   m.doc() = R"pbdoc(
         Wrapped functions defined in the `stan::services` namespace.
@@ -358,17 +914,91 @@ PYBIND11_MODULE(stan_services, m) {
         "Call the ``log_prob`` method of the model.");
   m.def("log_prob_grad", &log_prob_grad, py::arg("data"), py::arg("unconstrained_parameters"),
         py::arg("adjust_transform"), "Call stan::model::log_prob_grad");
+  m.def("log_prob_batch", &log_prob_batch, py::arg("data"), py::arg("unconstrained_parameters"),
+        py::arg("adjust_transform"), R"pbdoc(
+        Call the ``log_prob`` method of the model for many points.
+
+        ``unconstrained_parameters`` is a two-dimensional array with one row
+        per point. Points are evaluated in parallel. Returns an array with the
+        log density of each point.
+    )pbdoc");
+  m.def("log_prob_grad_batch", &log_prob_grad_batch, py::arg("data"), py::arg("unconstrained_parameters"),
+        py::arg("adjust_transform"), R"pbdoc(
+        Call stan::model::log_prob_grad for many points.
+
+        ``unconstrained_parameters`` is a two-dimensional array with one row
+        per point. Points are evaluated in parallel. Returns a tuple of an
+        array with the log density of each point and a (C-contiguous) array
+        with the gradient of each point as its rows.
+    )pbdoc");
+  m.def("hessian", &hessian, py::arg("data"), py::arg("unconstrained_parameters"), py::arg("adjust_transform"),
+        R"pbdoc(
+        Calculate the Hessian of the log density using forward-over-reverse autodiff.
+
+        Returns a tuple of the log density, its gradient and its Hessian, a
+        (C-contiguous) square array.
+    )pbdoc");
+  m.def("hessian_vector_product", &hessian_vector_product, py::arg("data"), py::arg("unconstrained_parameters"),
+        py::arg("vector"), py::arg("adjust_transform"), R"pbdoc(
+        Calculate the product of the Hessian of the log density and a vector.
+
+        Uses forward-over-reverse autodiff without forming the Hessian.
+        Returns a tuple of the log density and the product.
+    )pbdoc");
   m.def("write_array", &write_array, py::arg("data"), py::arg("unconstrained_parameters"), py::arg("include_tparams"),
         py::arg("include_gqs"), "Call the ``write_array`` method of the model.");
   m.def("transform_inits", &transform_inits, py::arg("data"), py::arg("constrained_parameters"),
         "Call the ``transform_inits`` method of the model.");
-  m.def("hmc_nuts_diag_e_adapt_wrapper", &hmc_nuts_diag_e_adapt_wrapper, py::arg("socket_filename"), py::arg("data"),
-        py::arg("init"), py::arg("random_seed"), py::arg("chain"), py::arg("init_radius"), py::arg("num_warmup"),
-        py::arg("num_samples"), py::arg("num_thin"), py::arg("save_warmup"), py::arg("refresh"), py::arg("stepsize"),
-        py::arg("stepsize_jitter"), py::arg("max_depth"), py::arg("delta"), py::arg("gamma"), py::arg("kappa"),
-        py::arg("t0"), py::arg("init_buffer"), py::arg("term_buffer"), py::arg("window"),
+  m.def("split_json_request", &split_json_request, py::arg("body"), py::arg("keys"),
+        R"pbdoc(
+        Find data objects in a JSON-encoded request body.
+
+        Returns a dict mapping each top-level member named in ``keys`` whose
+        value is an object to the JSON-encoded object (bytes) and the request
+        body with each of these values replaced by ``{}``. Data values are
+        validated but not converted into Python objects.
+    )pbdoc");
+  m.def("data_cache_info", &data_cache_info, R"pbdoc(
+        Return statistics about the cache of parsed JSON-encoded data.
+
+        Returns a dict with the number of cache ``hits`` and ``misses``, the
+        number of cached ``entries``, their estimated ``size`` in bytes and the
+        ``capacity`` of the cache in bytes.
+    )pbdoc");
+  m.def("set_data_cache_capacity", &set_data_cache_capacity, py::arg("capacity"),
+        "Set the capacity, in bytes, of the cache of parsed JSON-encoded data.");
+  m.def("clear_data_cache", &clear_data_cache, "Remove all entries from the cache of parsed JSON-encoded data.");
+  m.def("canonical_data_digest", &canonical_data_digest, py::arg("data"), R"pbdoc(
+        Return a hash (hex string) of the variables in ``data``.
+
+        ``data`` is a dict or a JSON-encoded object (bytes). The hash depends
+        only on the names, types, dimensions and values of the variables, not
+        on how they are encoded, e.g., on the order of members or whitespace.
+    )pbdoc");
+  m.def("model_pool_info", &model_pool_info, R"pbdoc(
+        Return statistics about the pool of constructed models.
+
+        Returns a dict with the number of pool ``hits`` and ``misses``, the
+        number of pooled models (``entries`` and ``size``) and the ``capacity``
+        of the pool, a number of models.
+    )pbdoc");
+  m.def("set_model_pool_capacity", &set_model_pool_capacity, py::arg("capacity"),
+        "Set the capacity, a number of models, of the pool of constructed models.");
+  m.def("clear_model_pool", &clear_model_pool, "Remove all models from the pool of constructed models.");
+  m.def("hmc_nuts_diag_e_adapt_wrapper", &hmc_nuts_diag_e_adapt_wrapper, py::arg("socket_filename"),
+        py::arg("fit_filename"), py::arg("data"), py::arg("init"), py::arg("random_seed"), py::arg("chain"),
+        py::arg("init_radius"), py::arg("num_warmup"), py::arg("num_samples"), py::arg("num_thin"),
+        py::arg("save_warmup"), py::arg("refresh"), py::arg("stepsize"), py::arg("stepsize_jitter"),
+        py::arg("max_depth"), py::arg("delta"), py::arg("gamma"), py::arg("kappa"), py::arg("t0"),
+        py::arg("init_buffer"), py::arg("term_buffer"), py::arg("window"),
+        py::arg("message_version") = 1, py::arg("significant_digits") = 0,
+        py::arg("include") = std::vector<std::string>(), py::arg("exclude") = std::vector<std::string>(),
+        py::arg("target_ess") = 0.0, py::arg("target_ess_parameters") = std::vector<std::string>(),
         "Call stan::services::sample::hmc_nuts_diag_e_adapt");
-  m.def("fixed_param_wrapper", &fixed_param_wrapper, py::arg("socket_filename"), py::arg("data"), py::arg("init"),
-        py::arg("random_seed"), py::arg("chain"), py::arg("init_radius"), py::arg("num_samples"), py::arg("num_thin"),
-        py::arg("refresh"), "Call stan::services::sample::fixed_param");
+  m.def("fixed_param_wrapper", &fixed_param_wrapper, py::arg("socket_filename"), py::arg("fit_filename"),
+        py::arg("data"), py::arg("init"), py::arg("random_seed"), py::arg("chain"), py::arg("init_radius"),
+        py::arg("num_samples"), py::arg("num_thin"), py::arg("refresh"), py::arg("message_version") = 1,
+        py::arg("significant_digits") = 0, py::arg("include") = std::vector<std::string>(),
+        py::arg("exclude") = std::vector<std::string>(), py::arg("target_ess") = 0.0,
+        py::arg("target_ess_parameters") = std::vector<std::string>(), "Call stan::services::sample::fixed_param");
 }
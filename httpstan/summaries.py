@@ -0,0 +1,254 @@
+"""Merge summaries of the draws in several fits.
+
+The process calling a stan::services function stores a summary of the draws
+alongside the fit (see ``httpstan/summary.hpp``): the mean, variance, minimum
+and maximum of each parameter and a t-digest of its draws, in the binary wire
+format (see ``httpstan.wire``). Summaries of several fits, e.g., one per
+chain, are merged here without reading the draws.
+
+Convergence diagnostics are computed from the means of blocks of
+consecutive draws of each chain (batch means). Split-R-hat is the potential
+scale reduction factor of Gelman et al. (Bayesian Data Analysis, 3rd ed.)
+computed on the first and second halves of each chain. The effective sample
+size (ESS) is the multi-chain ESS used by Stan, with autocorrelations of the
+block means, computed with the FFT, in place of autocorrelations of draws.
+With blocks of one draw, both equal their usual definitions. Draws are not
+rank-normalized, as ranks cannot be computed from running statistics.
+"""
+import json
+import typing
+
+import numpy as np
+
+import httpstan.wire as wire
+
+
+def decode(message: bytes) -> typing.Tuple[dict, typing.Dict[str, np.ndarray]]:
+    """Decode a summary stored alongside a fit.
+
+    Returns:
+        tuple: header (``num_draws``, ``compression``, ``names`` and ``fit``, how the fit was made) and arrays
+            keyed by name.
+
+    """
+    header, arrays = wire.decode(message)
+    return json.loads(header), arrays
+
+
+def quantiles(
+    parameters: np.ndarray,
+    centroid_means: np.ndarray,
+    centroid_weights: np.ndarray,
+    minimum: np.ndarray,
+    maximum: np.ndarray,
+    probabilities: typing.Sequence[float],
+) -> np.ndarray:
+    """Estimate quantiles of parameters from t-digest centroids.
+
+    Centroids may be in any order, so the centroids of several digests of a
+    parameter may simply be concatenated. Quantiles are interpolated as in
+    ``httpstan::tdigest::quantile``.
+
+    Arguments:
+        parameters: index of the parameter of each centroid.
+        centroid_means: means of the centroids.
+        centroid_weights: weights of the centroids.
+        minimum: smallest value of each parameter.
+        maximum: largest value of each parameter.
+        probabilities: probabilities of the quantiles.
+
+    Returns:
+        Array of quantiles with a row for each parameter and a column for each probability.
+
+    """
+    num_parameters = len(minimum)
+    result = np.full((num_parameters, len(probabilities)), np.nan)
+    if not len(centroid_means):
+        return result
+    order = np.lexsort((centroid_means, parameters))
+    means, weights = centroid_means[order], centroid_weights[order]
+    counts = np.bincount(parameters, minlength=num_parameters)
+    # positions are cumulative weights, over all parameters
+    totals = np.bincount(parameters, weights=centroid_weights, minlength=num_parameters)
+    ends = np.cumsum(totals)
+    starts = ends - totals
+    centers = np.cumsum(weights) - weights / 2
+    first = np.cumsum(counts) - counts
+    last = first + counts - 1
+
+    targets = starts[:, np.newaxis] + np.asarray(probabilities)[np.newaxis, :] * totals[:, np.newaxis]
+    # the first centroid whose center is at or after the target is on the right of the target
+    right = np.searchsorted(centers, targets)
+    left = right - 1
+    # before the first centroid of a parameter, interpolate from its smallest value
+    before = left < first[:, np.newaxis]
+    left = np.clip(left, 0, len(means) - 1)
+    left_position = np.where(before, starts[:, np.newaxis], centers[left])
+    left_value = np.where(before, minimum[:, np.newaxis], means[left])
+    # after the last centroid, interpolate to its largest value
+    after = right > last[:, np.newaxis]
+    right = np.clip(right, 0, len(means) - 1)
+    right_position = np.where(after, ends[:, np.newaxis], centers[right])
+    right_value = np.where(after, maximum[:, np.newaxis], means[right])
+
+    width = right_position - left_position
+    with np.errstate(divide="ignore", invalid="ignore"):
+        fraction = np.where(width > 0, (targets - left_position) / width, 1.0)
+    estimates = left_value + (right_value - left_value) * fraction
+    result[counts > 0] = estimates[counts > 0]
+    return result
+
+
+def _merge_blocks(block_means: np.ndarray, block_m2: np.ndarray, block_size: int) -> typing.Tuple[np.ndarray, ...]:
+    """Merge adjacent blocks, given as arrays with a row for each parameter, doubling the block size."""
+    n = block_means.shape[1] // 2
+    a, b = block_means[:, 0 : 2 * n : 2], block_means[:, 1 : 2 * n : 2]
+    m2 = block_m2[:, 0 : 2 * n : 2] + block_m2[:, 1 : 2 * n : 2] + (a - b) ** 2 * block_size / 2
+    return (a + b) / 2, m2
+
+
+def diagnostics(
+    chains: typing.Sequence[typing.Tuple[int, np.ndarray, np.ndarray]]
+) -> typing.Tuple[np.ndarray, np.ndarray]:
+    """Compute split-R-hat and the effective sample size from block statistics.
+
+    Blocks of chains with smaller blocks are merged until all chains have
+    blocks of the same size. Each chain is split into two halves with the
+    same number of blocks, dropping the middle block if there is an odd
+    number of blocks, and all halves are cut to the length of the shortest.
+
+    Arguments:
+        chains: block size, block means and block sums of squared differences
+            from the mean, with a row for each parameter, for each chain.
+
+    Returns:
+        tuple: split-R-hat and ESS of each parameter, NaN if there are fewer
+            than two blocks in each half of a chain or if draws do not vary.
+
+    """
+    block_size = max(size for size, _, _ in chains)
+    halves = []
+    for size, block_means, block_m2 in chains:
+        while size < block_size:
+            block_means, block_m2 = _merge_blocks(block_means, block_m2, size)
+            size *= 2
+        halves.append((block_means, block_m2))
+    num_parameters = chains[0][1].shape[0]
+    length = min(block_means.shape[1] for block_means, _ in halves) // 2
+    if length < 2:
+        nan = np.full(num_parameters, np.nan)
+        return nan, nan
+    # block means and sums of squares of the halves, shape (parameters, halves, blocks)
+    parts = [(slice(0, length), slice(m.shape[1] - length, None)) for m, _ in halves]
+    x = np.stack([m[:, part] for (m, _), pair in zip(halves, parts) for part in pair], 1)
+    x_m2 = np.stack([m2[:, part] for (_, m2), pair in zip(halves, parts) for part in pair], 1)
+    num_halves = x.shape[1]
+    n = length * block_size
+
+    with np.errstate(divide="ignore", invalid="ignore"):
+        # split-R-hat
+        half_means = x.mean(axis=2)
+        centered = x - half_means[:, :, np.newaxis]
+        half_variances = (x_m2.sum(axis=2) + block_size * (centered ** 2).sum(axis=2)) / (n - 1)
+        within = half_variances.mean(axis=1)
+        between = half_means.var(axis=1, ddof=1)
+        var_plus = (n - 1) / n * within + between
+        split_rhat = np.sqrt(var_plus / within)
+
+        # autocovariances of the block means of each half, with zero padding to avoid circular correlation
+        transform = np.fft.rfft(centered, n=2 * length, axis=2)
+        acov = np.fft.irfft(transform * np.conj(transform), n=2 * length, axis=2)[:, :, :length] / length
+        within_blocks = (acov[:, :, 0] * length / (length - 1)).mean(axis=1)
+        var_plus_blocks = (length - 1) / length * within_blocks + between
+        rho = 1 - (within_blocks[:, np.newaxis] - acov.mean(axis=1)) / var_plus_blocks[:, np.newaxis]
+        rho[:, 0] = 1
+        # Geyer's initial monotone sequence estimator
+        pairs = rho[:, 0 : 2 * (length // 2) : 2] + rho[:, 1 : 2 * (length // 2) : 2]
+        positive = np.cumprod(pairs > 0, axis=1).astype(bool)
+        pairs = np.minimum.accumulate(np.where(positive, pairs, np.inf), axis=1)
+        tau = -1 + 2 * np.where(positive, pairs, 0).sum(axis=1)
+        num_draws = num_halves * n
+        # as in Stan, tau is at least 1 / log10(num_draws), which keeps the ESS of anticorrelated draws positive
+        tau = np.maximum(tau, 1 / np.log10(num_draws))
+        # the variance of the mean of the draws is the variance of the mean of the blocks
+        ess = num_halves * length / tau * var_plus / var_plus_blocks
+        ess = np.minimum(ess, num_draws * np.log10(num_draws))
+    return split_rhat, ess
+
+
+def merge(summaries: typing.Sequence[bytes], probabilities: typing.Sequence[float]) -> dict:
+    """Merge summaries of fits of the same model.
+
+    Means and variances are combined as described by Chan, Golub and LeVeque
+    ("Algorithms for Computing the Sample Variance"). Quantiles are estimated
+    from the combined centroids of the t-digests. Each fit is a chain for the
+    convergence diagnostics, see ``diagnostics``.
+
+    Arguments:
+        summaries: summaries stored alongside fits.
+        probabilities: probabilities of the quantiles.
+
+    Returns:
+        Merged summary, in the form of the summary of a single fit (see ``httpstan.schemas.FitSummary``).
+
+    Raises:
+        ValueError: the summaries do not have the same parameters, or the
+            fits were made with different functions, data or arguments.
+
+    """
+    decoded = [decode(summary) for summary in summaries]
+    names = decoded[0][0]["names"]
+    if any(header["names"] != names for header, _ in decoded):
+        raise ValueError("Fits do not have the same parameters.")
+    # how each fit was made, see `describe_fit` in `httpstan/stan_services.cpp`
+    fit = decoded[0][0].get("fit", {})
+    for key, description in (("function", "function"), ("data", "data"), ("arguments", "sampler arguments")):
+        if any(header.get("fit", {}).get(key) != fit.get(key) for header, _ in decoded):
+            raise ValueError(f"Fits were not made with the same {description}.")
+
+    counts = np.array([header["num_draws"] for header, _ in decoded], dtype=np.float64)[:, np.newaxis]
+    num_draws = counts.sum()
+    means = np.stack([arrays["mean"] for _, arrays in decoded])
+    variances = np.stack([arrays["variance"] for _, arrays in decoded])
+    # statistics of fits without draws are NaN, they do not contribute
+    with np.errstate(divide="ignore", invalid="ignore"):
+        mean = np.where(counts > 0, counts * means, 0).sum(axis=0) / num_draws
+        m2 = np.where(counts > 1, (counts - 1) * variances, 0) + np.where(counts > 0, counts * (means - mean) ** 2, 0)
+        variance = m2.sum(axis=0) / (num_draws - 1) if num_draws > 1 else np.full(len(names), np.nan)
+    minimum = np.fmin.reduce(np.stack([arrays["min"] for _, arrays in decoded]))
+    maximum = np.fmax.reduce(np.stack([arrays["max"] for _, arrays in decoded]))
+
+    # the centroids of all digests of a parameter are combined
+    parameters = np.concatenate(
+        [np.repeat(np.arange(len(names)), arrays["num_centroids"].astype(np.int64)) for _, arrays in decoded]
+    )
+    centroid_means = np.concatenate([arrays["centroid_means"] for _, arrays in decoded])
+    centroid_weights = np.concatenate([arrays["centroid_weights"] for _, arrays in decoded])
+    estimates = quantiles(parameters, centroid_means, centroid_weights, minimum, maximum, probabilities)
+
+    chains = [
+        (
+            header["block_size"],
+            arrays["block_means"].reshape(len(names), header["num_blocks"]),
+            arrays["block_m2"].reshape(len(names), header["num_blocks"]),
+        )
+        for header, arrays in decoded
+    ]
+    split_rhat, ess = diagnostics(chains)
+
+    return {
+        "num_draws": int(num_draws),
+        "probabilities": list(probabilities),
+        "parameters": {
+            name: {
+                "mean": float(mean[i]),
+                "variance": float(variance[i]),
+                "min": float(minimum[i]),
+                "max": float(maximum[i]),
+                "quantiles": estimates[i].tolist(),
+                "split_rhat": float(split_rhat[i]),
+                "ess": float(ess[i]),
+            }
+            for i, name in enumerate(names)
+        },
+    }
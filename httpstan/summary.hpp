@@ -0,0 +1,326 @@
+#ifndef HTTPSTAN_SUMMARY_HPP
+#define HTTPSTAN_SUMMARY_HPP
+
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tdigest.hpp"
+#include "wire.hpp"
+
+namespace httpstan {
+
+/**
+ * Summary statistics of each column of the draws written by a sample writer,
+ * updated as draws arrive so the draws need not be read again.
+ *
+ * Mean and variance are computed with Welford's algorithm, which is
+ * numerically stable and needs constant memory per column. Quantiles are
+ * estimated from a <code>tdigest</code> of each column.
+ *
+ * For convergence diagnostics (see ``httpstan.summaries``), draws are also
+ * summarized in consecutive blocks of equal size: the mean and the sum of
+ * squared differences from the mean of each block. There are at most
+ * `max_blocks` blocks; when there are that many, adjacent blocks are merged
+ * and the block size doubles. Draws after the last complete block are not in
+ * any block. The effective sample size of each column is estimated from the
+ * block means (see <code>ess</code>).
+ */
+class summary {
+private:
+  using json_writer = rapidjson::Writer<rapidjson::StringBuffer, rapidjson::UTF8<>, rapidjson::UTF8<>,
+                                        rapidjson::CrtAllocator, rapidjson::kWriteNanAndInfFlag>;
+
+  static constexpr std::size_t max_blocks = 64;
+
+  struct column {
+    double mean = 0;
+    // sum of squared differences from the mean
+    double m2 = 0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    // complete blocks
+    std::vector<double> block_means;
+    std::vector<double> block_m2;
+    // the block being filled
+    double current_mean = 0;
+    double current_m2 = 0;
+  };
+
+  std::vector<std::string> names_;
+  std::vector<column> columns_;
+  // compressing a digest does not change the values it holds, so it is done when needed, even in const methods
+  mutable std::vector<tdigest> digests_;
+  uint64_t num_draws_ = 0;
+  uint64_t block_size_ = 1;
+  // draws in the block being filled
+  uint64_t num_block_draws_ = 0;
+
+  /**
+   * Merge adjacent blocks, doubling the block size.
+   */
+  void merge_blocks() {
+    for (column &c : columns_) {
+      const std::size_t n = c.block_means.size() / 2;
+      for (std::size_t j = 0; j < n; ++j) {
+        const double a = c.block_means[2 * j], b = c.block_means[2 * j + 1];
+        // Chan et al.'s formula for the union of two sets of equal size
+        c.block_m2[j] = c.block_m2[2 * j] + c.block_m2[2 * j + 1] + (a - b) * (a - b) * block_size_ / 2;
+        c.block_means[j] = (a + b) / 2;
+      }
+      c.block_means.resize(n);
+      c.block_m2.resize(n);
+    }
+    block_size_ *= 2;
+  }
+
+  double mean(const column &c) const { return num_draws_ > 0 ? c.mean : std::numeric_limits<double>::quiet_NaN(); }
+  double variance(const column &c) const {
+    return num_draws_ > 1 ? c.m2 / static_cast<double>(num_draws_ - 1) : std::numeric_limits<double>::quiet_NaN();
+  }
+  double min(const column &c) const { return num_draws_ > 0 ? c.min : std::numeric_limits<double>::quiet_NaN(); }
+  double max(const column &c) const { return num_draws_ > 0 ? c.max : std::numeric_limits<double>::quiet_NaN(); }
+
+public:
+  /**
+   * Set the names of the columns and discard all draws.
+   *
+   * @param[in] names names of the columns
+   */
+  void set_names(const std::vector<std::string> &names) {
+    names_ = names;
+    reset();
+  }
+
+  /**
+   * Discard all draws, e.g., warmup draws once adaptation ends.
+   */
+  void reset() {
+    columns_.assign(names_.size(), column());
+    digests_.assign(names_.size(), tdigest());
+    num_draws_ = 0;
+    block_size_ = 1;
+    num_block_draws_ = 0;
+  }
+
+  const std::vector<std::string> &names() const { return names_; }
+
+  uint64_t num_draws() const { return num_draws_; }
+
+  uint64_t block_size() const { return block_size_; }
+
+  /**
+   * Returns true if there are draws and all draws of a column are equal, e.g., for a constant generated quantity.
+   * Their effective sample size is NaN.
+   *
+   * @param[in] i index of the column
+   */
+  bool constant(std::size_t i) const { return num_draws_ > 0 && columns_.at(i).min == columns_.at(i).max; }
+
+  /**
+   * Estimate the effective sample size of a column from its block means.
+   *
+   * This is the single-chain ESS used by Stan, with autocorrelations of the
+   * block means in place of autocorrelations of draws, truncated with
+   * Geyer's initial monotone sequence. With blocks of one draw, it is the
+   * usual ESS. As in Stan, the integrated autocorrelation time is at least
+   * 1 / log10(n) for n draws, so the ESS of anticorrelated draws is positive
+   * and at most n log10(n). Returns NaN if there are fewer than 4 blocks or
+   * the block means do not vary.
+   *
+   * @param[in] i index of the column
+   */
+  double ess(std::size_t i) const {
+    const std::vector<double> &x = columns_.at(i).block_means;
+    const std::size_t m = x.size();
+    if (m < 4)
+      return std::numeric_limits<double>::quiet_NaN();
+    double mean = 0;
+    for (double value : x)
+      mean += value / static_cast<double>(m);
+    std::vector<double> acov(m, 0.0);
+    for (std::size_t t = 0; t < m; ++t)
+      for (std::size_t j = 0; j + t < m; ++j)
+        acov[t] += (x[j] - mean) * (x[j + t] - mean) / static_cast<double>(m);
+    if (!(acov[0] > 0))
+      return std::numeric_limits<double>::quiet_NaN();
+    // sums of pairs of autocorrelations are positive and decreasing up to where the sequence is truncated
+    double tau = -1;
+    double previous = std::numeric_limits<double>::infinity();
+    for (std::size_t t = 0; t + 1 < m; t += 2) {
+      const double pair = (acov[t] + acov[t + 1]) / acov[0];
+      if (pair <= 0)
+        break;
+      previous = std::min(previous, pair);
+      tau += 2 * previous;
+    }
+    const double n = static_cast<double>(m * block_size_);
+    // a negative lag-1 autocorrelation can leave tau below 1 / log10(n), or negative
+    tau = std::max(tau, 1 / std::log10(n));
+    // the variance of the mean of the draws is the variance of the mean of the blocks
+    const double block_variance = acov[0] * static_cast<double>(m) / static_cast<double>(m - 1);
+    const double ess = static_cast<double>(m) * variance(columns_[i]) / (block_variance * tau);
+    return std::min(ess, n * std::log10(n));
+  }
+
+  /**
+   * Returns the probabilities of the quantiles in the summary.
+   */
+  static const std::vector<double> &probabilities() {
+    static const std::vector<double> probabilities = {0.05, 0.5, 0.95};
+    return probabilities;
+  }
+
+  /**
+   * Add a draw.
+   *
+   * @param[in] draw one value for each column
+   */
+  void add(const std::vector<double> &draw) {
+    if (draw.size() != columns_.size())
+      throw std::invalid_argument("Draw has " + std::to_string(draw.size()) + " values, expected "
+                                  + std::to_string(columns_.size()) + ".");
+    ++num_draws_;
+    ++num_block_draws_;
+    for (std::size_t i = 0; i < draw.size(); ++i) {
+      column &c = columns_[i];
+      const double delta = draw[i] - c.mean;
+      c.mean += delta / static_cast<double>(num_draws_);
+      c.m2 += delta * (draw[i] - c.mean);
+      c.min = std::min(c.min, draw[i]);
+      c.max = std::max(c.max, draw[i]);
+      digests_[i].add(draw[i]);
+      const double block_delta = draw[i] - c.current_mean;
+      c.current_mean += block_delta / static_cast<double>(num_block_draws_);
+      c.current_m2 += block_delta * (draw[i] - c.current_mean);
+    }
+    if (num_block_draws_ < block_size_)
+      return;
+    for (column &c : columns_) {
+      c.block_means.push_back(c.current_mean);
+      c.block_m2.push_back(c.current_m2);
+      c.current_mean = c.current_m2 = 0;
+    }
+    num_block_draws_ = 0;
+    if (!columns_.empty() && columns_[0].block_means.size() == max_blocks)
+      merge_blocks();
+  }
+
+  /**
+   * Returns the summary as a JSON object:
+   *   {"num_draws":1000,"truncated":false,"probabilities":[0.05,0.5,0.95],
+   *    "parameters":{"lp__":{"mean":...,"variance":...,"min":...,"max":...,"quantiles":[...],"ess":...},...}}
+   * Variance is the sample variance. Statistics which are undefined, e.g., the
+   * variance of a single draw, are NaN.
+   *
+   * @param[in] truncated true if sampling stopped before all draws were made
+   */
+  std::string to_json(bool truncated = false) const {
+    rapidjson::StringBuffer buffer;
+    json_writer writer(buffer);
+    writer.StartObject();
+    writer.String("num_draws");
+    writer.Uint64(num_draws_);
+    writer.String("truncated");
+    writer.Bool(truncated);
+    writer.String("probabilities");
+    writer.StartArray();
+    for (double probability : probabilities())
+      writer.Double(probability);
+    writer.EndArray();
+    writer.String("parameters");
+    writer.StartObject();
+    for (std::size_t i = 0; i < columns_.size(); ++i) {
+      const column &c = columns_[i];
+      writer.String(names_[i].c_str());
+      writer.StartObject();
+      writer.String("mean");
+      writer.Double(mean(c));
+      writer.String("variance");
+      writer.Double(variance(c));
+      writer.String("min");
+      writer.Double(min(c));
+      writer.String("max");
+      writer.Double(max(c));
+      writer.String("quantiles");
+      writer.StartArray();
+      digests_[i].compress();
+      for (double probability : probabilities())
+        writer.Double(digests_[i].quantile(probability, c.min, c.max));
+      writer.EndArray();
+      writer.String("ess");
+      writer.Double(ess(i));
+      writer.EndObject();
+    }
+    writer.EndObject();
+    writer.EndObject();
+    return std::string(buffer.GetString(), buffer.GetSize());
+  }
+
+  /**
+   * Returns the summary, including the centroids of the digests, in the
+   * binary wire format (see ``httpstan.wire``), for merging with the
+   * summaries of other chains (see ``httpstan.summaries``). The header holds
+   * ``num_draws``, the ``compression`` of the digests and the ``names`` of
+   * the columns, as well as the ``block_size`` and ``num_blocks``. The
+   * arrays are ``mean``, ``variance``, ``min`` and ``max``, with a value for
+   * each column, ``num_centroids``, the number of centroids of each column,
+   * ``centroid_means`` and ``centroid_weights``, the centroids of all
+   * columns, and ``block_means`` and ``block_m2``, the means and sums of
+   * squared differences from the mean of the blocks of all columns. Values
+   * of columns are column after column.
+   *
+   * @param[in] fit JSON object describing how the fit was made, stored as ``fit`` in the header. Summaries of
+   * fits made differently are not merged.
+   */
+  std::string to_wire(const std::string &fit = "{}") const {
+    rapidjson::StringBuffer buffer;
+    json_writer writer(buffer);
+    writer.StartObject();
+    writer.String("num_draws");
+    writer.Uint64(num_draws_);
+    writer.String("compression");
+    writer.Double(tdigest().compression());
+    writer.String("block_size");
+    writer.Uint64(block_size_);
+    writer.String("num_blocks");
+    writer.Uint64(columns_.empty() ? 0 : columns_[0].block_means.size());
+    writer.String("names");
+    writer.StartArray();
+    for (const std::string &name : names_)
+      writer.String(name.c_str());
+    writer.EndArray();
+    writer.String("fit");
+    writer.RawValue(fit.c_str(), fit.size(), rapidjson::kObjectType);
+    writer.EndObject();
+
+    std::vector<std::pair<std::string, std::vector<double>>> arrays = {
+        {"mean", {}}, {"variance", {}}, {"min", {}}, {"max", {}}, {"num_centroids", {}}, {"centroid_means", {}},
+        {"centroid_weights", {}}, {"block_means", {}}, {"block_m2", {}}};
+    for (std::size_t i = 0; i < columns_.size(); ++i) {
+      const column &c = columns_[i];
+      digests_[i].compress();
+      arrays[0].second.push_back(mean(c));
+      arrays[1].second.push_back(variance(c));
+      arrays[2].second.push_back(min(c));
+      arrays[3].second.push_back(max(c));
+      arrays[4].second.push_back(static_cast<double>(digests_[i].means().size()));
+      arrays[5].second.insert(arrays[5].second.end(), digests_[i].means().begin(), digests_[i].means().end());
+      arrays[6].second.insert(arrays[6].second.end(), digests_[i].weights().begin(), digests_[i].weights().end());
+      arrays[7].second.insert(arrays[7].second.end(), c.block_means.begin(), c.block_means.end());
+      arrays[8].second.insert(arrays[8].second.end(), c.block_m2.begin(), c.block_m2.end());
+    }
+    return wire::encode(std::string(buffer.GetString(), buffer.GetSize()), arrays);
+  }
+};
+
+} // namespace httpstan
+#endif // HTTPSTAN_SUMMARY_HPP
@@ -0,0 +1,158 @@
+#ifndef HTTPSTAN_TDIGEST_HPP
+#define HTTPSTAN_TDIGEST_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+namespace httpstan {
+
+/**
+ * <code>tdigest</code> is a sketch of a distribution from which quantiles
+ * are estimated: a merging t-digest (Dunning and Ertl, "Computing Extremely
+ * Accurate Quantiles Using t-Digests").
+ *
+ * The sketch is a list of centroids (a mean and a weight) sorted by mean.
+ * Centroids near the tails hold few values, so extreme quantiles are
+ * accurate. Values are buffered and merged into the centroids when the
+ * buffer is full, so adding a value is cheap. Sketches are merged by
+ * combining their centroids (see ``httpstan.summaries``).
+ *
+ * Values which are not finite are ignored.
+ */
+class tdigest {
+private:
+  static constexpr double pi = 3.14159265358979323846;
+
+  double compression_;
+  // values are merged into the centroids when this many are buffered
+  std::size_t buffer_size_;
+  std::vector<double> means_;
+  std::vector<double> weights_;
+  std::vector<double> buffer_;
+
+  // the scale function, which bounds the size of centroids: the weight of a
+  // centroid spans an interval of length at most 1 of k
+  double k(double q) const { return compression_ / (2 * pi) * std::asin(2 * q - 1); }
+  double k_inverse(double k) const {
+    if (k >= compression_ / 4)
+      return 1;
+    return (std::sin(2 * pi * k / compression_) + 1) / 2;
+  }
+
+public:
+  /**
+   * @param[in] compression bound on the number of centroids, larger values give more accurate quantiles
+   */
+  explicit tdigest(double compression = 100)
+      : compression_(compression), buffer_size_(static_cast<std::size_t>(2 * compression)) {}
+
+  void add(double value) {
+    if (!std::isfinite(value))
+      return;
+    buffer_.push_back(value);
+    if (buffer_.size() >= buffer_size_)
+      compress();
+  }
+
+  /**
+   * Merge buffered values into the centroids.
+   */
+  void compress() {
+    if (buffer_.empty())
+      return;
+    std::vector<std::size_t> order(means_.size() + buffer_.size());
+    std::iota(order.begin(), order.end(), 0);
+    auto mean = [this](std::size_t i) { return i < means_.size() ? means_[i] : buffer_[i - means_.size()]; };
+    auto weight = [this](std::size_t i) { return i < weights_.size() ? weights_[i] : 1.0; };
+    std::sort(order.begin(), order.end(), [&mean](std::size_t a, std::size_t b) { return mean(a) < mean(b); });
+
+    const double total = std::accumulate(weights_.begin(), weights_.end(), 0.0) + buffer_.size();
+    std::vector<double> means, weights;
+    // weight of the centroids before the current one
+    double merged = 0;
+    double current_mean = mean(order[0]);
+    double current_weight = weight(order[0]);
+    double q_limit = k_inverse(k(0) + 1);
+    for (std::size_t j = 1; j < order.size(); ++j) {
+      const double m = mean(order[j]);
+      const double w = weight(order[j]);
+      if ((merged + current_weight + w) / total <= q_limit) {
+        current_weight += w;
+        current_mean += (m - current_mean) * w / current_weight;
+      } else {
+        means.push_back(current_mean);
+        weights.push_back(current_weight);
+        merged += current_weight;
+        q_limit = k_inverse(k(merged / total) + 1);
+        current_mean = m;
+        current_weight = w;
+      }
+    }
+    means.push_back(current_mean);
+    weights.push_back(current_weight);
+    means_.swap(means);
+    weights_.swap(weights);
+    buffer_.clear();
+  }
+
+  /**
+   * Discard all values.
+   */
+  void reset() {
+    means_.clear();
+    weights_.clear();
+    buffer_.clear();
+  }
+
+  double compression() const { return compression_; }
+
+  /**
+   * Returns the means of the centroids, in increasing order. Call <code>compress</code> first.
+   */
+  const std::vector<double> &means() const { return means_; }
+
+  /**
+   * Returns the weights of the centroids. Call <code>compress</code> first.
+   */
+  const std::vector<double> &weights() const { return weights_; }
+
+  /**
+   * Estimate a quantile, interpolating linearly between the centers of
+   * centroids and, in the tails, the smallest and largest values. Call
+   * <code>compress</code> first. Returns NaN if there are no values.
+   *
+   * @param[in] probability probability of the quantile, between 0 and 1
+   * @param[in] min smallest value
+   * @param[in] max largest value
+   */
+  double quantile(double probability, double min, double max) const {
+    if (means_.empty())
+      return std::numeric_limits<double>::quiet_NaN();
+    const double total = std::accumulate(weights_.begin(), weights_.end(), 0.0);
+    const double target = probability * total;
+    // position and value of the point before and after the target
+    double left_position = 0, left_value = min;
+    double position = 0;
+    for (std::size_t i = 0; i < means_.size(); ++i) {
+      const double center = position + weights_[i] / 2;
+      if (target <= center) {
+        if (center == left_position)
+          return means_[i];
+        return left_value + (means_[i] - left_value) * (target - left_position) / (center - left_position);
+      }
+      left_position = center;
+      left_value = means_[i];
+      position += weights_[i];
+    }
+    if (total == left_position)
+      return max;
+    return left_value + (max - left_value) * (target - left_position) / (total - left_position);
+  }
+};
+
+} // namespace httpstan
+#endif // HTTPSTAN_TDIGEST_HPP
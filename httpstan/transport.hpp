@@ -0,0 +1,170 @@
+#ifndef HTTPSTAN_TRANSPORT_HPP
+#define HTTPSTAN_TRANSPORT_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "fit_file.hpp"
+
+namespace httpstan {
+
+/**
+ * <code>transport</code> stores the messages from the logger and the writers
+ * used in a call to a stan::services function in a fit and sends the
+ * messages from the logger to the server, which reports progress.
+ *
+ * The worker process writes the fit itself (see <code>fit_file</code>), so
+ * draws do not pass through the server.
+ *
+ * Each message sent to the server is in a frame: an 8-byte header followed by
+ * the message. The header holds the channel (uint8), three reserved zero
+ * bytes and the length of the message in bytes (little-endian uint32).
+ *
+ * Frames are collected in a buffer which is sent when it holds `max_bytes`
+ * bytes or `max_messages` messages, or when a message is added `max_delay`
+ * after the buffer was last sent. Derived classes send the buffer and must
+ * call <code>finish_noexcept</code> when they are destroyed.
+ */
+class transport {
+private:
+  fit_file fit_file_;
+
+  std::string buffer_;
+  std::size_t num_messages_ = 0;
+  std::chrono::steady_clock::time_point last_flush_;
+
+  std::size_t max_bytes_;
+  std::size_t max_messages_;
+  std::chrono::steady_clock::duration max_delay_;
+
+  void append_header(channel channel_id, std::size_t size) {
+    const uint32_t length = static_cast<uint32_t>(size);
+    const char header[8] = {static_cast<char>(channel_id),
+                            0,
+                            0,
+                            0,
+                            static_cast<char>(length & 0xFF),
+                            static_cast<char>((length >> 8) & 0xFF),
+                            static_cast<char>((length >> 16) & 0xFF),
+                            static_cast<char>((length >> 24) & 0xFF)};
+    buffer_.append(header, sizeof(header));
+  }
+
+  void message_added() {
+    ++num_messages_;
+    if (buffer_.size() >= max_bytes_ || num_messages_ >= max_messages_
+        || std::chrono::steady_clock::now() - last_flush_ >= max_delay_)
+      flush();
+  }
+
+protected:
+  /**
+   * Send `size` bytes of frames to the server.
+   */
+  virtual void send(const char *data, std::size_t size) = 0;
+
+  /**
+   * Commit the fit and send buffered frames, ignoring errors. For use in destructors.
+   */
+  void finish_noexcept() noexcept {
+    try {
+      finish();
+    } catch (...) {
+    }
+  }
+
+public:
+  /**
+   * @param[in] fit_filename path of the fit
+   * @param[in] max_bytes size of the buffer in bytes
+   * @param[in] max_messages number of messages after which the buffer is sent
+   * @param[in] max_delay time after which the buffer is sent when a message is added
+   */
+  explicit transport(const std::string &fit_filename, std::size_t max_bytes = 64 * 1024,
+                     std::size_t max_messages = 1024,
+                     std::chrono::steady_clock::duration max_delay = std::chrono::milliseconds(100))
+      : fit_file_(fit_filename),
+        last_flush_(std::chrono::steady_clock::now()),
+        max_bytes_(max_bytes),
+        max_messages_(max_messages),
+        max_delay_(max_delay) {
+    buffer_.reserve(max_bytes_);
+  }
+
+  transport(const transport &) = delete;
+  transport &operator=(const transport &) = delete;
+
+  virtual ~transport() {}
+
+  /**
+   * Write a message to the fit. Messages from the logger are also added to
+   * the buffer, which is sent if a threshold is reached.
+   *
+   * @param[in] channel_id channel of the message
+   * @param[in] data pointer to the message
+   * @param[in] size size of the message in bytes
+   */
+  void write(channel channel_id, const char *data, std::size_t size) {
+    fit_file_.write(channel_id, data, size);
+    if (channel_id != channel::logger)
+      return;
+    append_header(channel_id, size);
+    buffer_.append(data, size);
+    message_added();
+  }
+
+  /**
+   * Write a message followed by a newline.
+   *
+   * @param[in] channel_id channel of the message
+   * @param[in] message message, without a trailing newline
+   * @param[in] size size of the message in bytes
+   */
+  void write_line(channel channel_id, const char *message, std::size_t size) {
+    fit_file_.write(channel_id, message, size);
+    fit_file_.write(channel_id, "\n", 1);
+    if (channel_id != channel::logger)
+      return;
+    append_header(channel_id, size + 1);
+    buffer_.append(message, size);
+    buffer_.push_back('\n');
+    message_added();
+  }
+
+  /**
+   * Store a file alongside the fit (see <code>fit_file::add_sidecar</code>).
+   *
+   * @param[in] suffix suffix added to the path of the fit to give the path of the file
+   * @param[in] contents contents of the file
+   */
+  void add_sidecar(const std::string &suffix, std::string contents) {
+    fit_file_.add_sidecar(suffix, std::move(contents));
+  }
+
+  /**
+   * Send all buffered messages.
+   */
+  void flush() {
+    if (!buffer_.empty())
+      send(buffer_.data(), buffer_.size());
+    buffer_.clear();
+    num_messages_ = 0;
+    last_flush_ = std::chrono::steady_clock::now();
+  }
+
+  /**
+   * Commit the fit and send all buffered messages. The fit is in place
+   * before the server sees the end of the messages. No messages may be
+   * written afterwards.
+   */
+  void finish() {
+    fit_file_.commit();
+    flush();
+  }
+};
+
+} // namespace httpstan
+#endif // HTTPSTAN_TRANSPORT_HPP
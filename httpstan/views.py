@@ -4,15 +4,19 @@ Handlers are separated from the endpoint names. Endpoints are defined in
 `httpstan.routes`.
 """
 import asyncio
+import concurrent.futures
 import functools
 import http
+import json
 import logging
 import re
 import traceback
-from typing import Optional, Sequence, cast
+from types import ModuleType
+from typing import Any, Callable, Dict, Optional, Sequence, Type, cast
 
 import aiohttp.web
-import lz4.frame
+import marshmallow
+import numpy as np
 import webargs.aiohttpparser
 
 import httpstan.cache
@@ -20,9 +24,16 @@ import httpstan.fits
 import httpstan.models
 import httpstan.schemas as schemas
 import httpstan.services_stub as services_stub
+import httpstan.summaries
+import httpstan.wire as wire
+from httpstan.config import HTTPSTAN_NUM_THREADS
 
 logger = logging.getLogger("httpstan")
 
+# Functions in the services extension module which evaluate the model release
+# the GIL. They are called in this thread pool, keeping the event loop free.
+executor = concurrent.futures.ThreadPoolExecutor(max_workers=HTTPSTAN_NUM_THREADS)
+
 
 # match a string such as `Iteration: 2000 / 2000 [100%]  (Sampling)`
 iteration_info_re = re.compile(rb"Iteration:\s+\d+ / \d+ \[\s*\d+%\]\s+\(\w+\)")
@@ -35,6 +46,80 @@ def _make_error(message: str, status: int, details: Optional[Sequence] = None) -
     return cast(dict, schemas.Status().load(status_dict))
 
 
+async def _parse_args(
+    request: aiohttp.web.Request, schema: marshmallow.Schema, services_module: ModuleType, data_keys: Sequence[str]
+) -> dict:
+    """Parse request arguments, leaving data for Stan JSON-encoded.
+
+    Members of the request body named in ``data_keys`` (e.g., ``data``) are
+    located and validated by the services extension module and returned as
+    JSON-encoded bytes. The extension module parses these bytes directly,
+    without creating intermediate Python objects. The remaining arguments are
+    validated using ``schema``.
+
+    A request body in the binary wire format (see ``httpstan.wire``) is also
+    accepted. Arrays in the body are returned as NumPy arrays.
+
+    If the request body is invalid, it is parsed by webargs, which reports
+    errors in the usual way.
+
+    """
+    body = await request.read()
+    arrays: Dict[str, np.ndarray] = {}
+    if request.content_type == wire.MEDIA_TYPE:
+        try:
+            body, arrays = wire.decode(body)
+        except ValueError as exc:
+            raise _http_error(aiohttp.web.HTTPBadRequest, f"Invalid request body: `{exc}`")
+        unknown = set(arrays) - set(schema.fields)
+        if unknown:
+            raise _http_error(aiohttp.web.HTTPBadRequest, f"Unexpected arrays in request body: `{sorted(unknown)}`")
+    try:
+        data_members, remainder = services_module.split_json_request(body, list(data_keys))  # type: ignore
+        args = schema.load(json.loads(remainder), partial=tuple(arrays))
+    except (ValueError, marshmallow.ValidationError):
+        if request.content_type != wire.MEDIA_TYPE:
+            return cast(dict, await webargs.aiohttpparser.parser.parse(schema, request))
+        data_members, args = {}, _load_header(schema, body, arrays)
+    args.update(data_members)
+    args.update(arrays)
+    return cast(dict, args)
+
+
+def _load_header(schema: marshmallow.Schema, header: bytes, arrays: Dict[str, np.ndarray]) -> dict:
+    """Validate the header of a request in the binary wire format, reporting errors as webargs does."""
+    try:
+        return cast(dict, schema.load(json.loads(header), partial=tuple(arrays)))
+    except ValueError:
+        raise _http_error(aiohttp.web.HTTPBadRequest, "Header of request body is not a JSON-encoded object.")
+    except marshmallow.ValidationError as exc:
+        raise aiohttp.web.HTTPUnprocessableEntity(
+            text=json.dumps({"json": exc.messages}), content_type="application/json"
+        )
+
+
+def _http_error(exception_class: Type[aiohttp.web.HTTPException], message: str) -> aiohttp.web.HTTPException:
+    status = exception_class.status_code
+    return exception_class(text=json.dumps(_make_error(message, status=status)), content_type="application/json")
+
+
+async def _call(function: Callable, *args: Any) -> Any:
+    """Call a function of the services extension module in the thread pool."""
+    return await asyncio.get_running_loop().run_in_executor(executor, functools.partial(function, *args))
+
+
+def _make_response(request: aiohttp.web.Request, arrays: Dict[str, Any]) -> aiohttp.web.Response:
+    """Return numbers or arrays of numbers keyed by name.
+
+    The response is JSON-encoded unless the request accepts the binary wire
+    format (see ``httpstan.wire``).
+
+    """
+    if wire.MEDIA_TYPE in request.headers.get("Accept", ""):
+        return aiohttp.web.Response(body=wire.encode(b"{}", arrays), content_type=wire.MEDIA_TYPE)
+    return aiohttp.web.json_response({name: np.asarray(value).tolist() for name, value in arrays.items()})
+
+
 async def handle_health(request: aiohttp.web.Request) -> aiohttp.web.Response:
     """Return 200 OK.
 
@@ -187,11 +272,15 @@ async def handle_delete_model(request: aiohttp.web.Request) -> aiohttp.web.Respo
     model_name = f"models/{request.match_info['model_id']}"
 
     try:
-        httpstan.models.import_services_extension_module(model_name)
+        services_module = httpstan.models.import_services_extension_module(model_name)
     except KeyError:  # pragma: no cover
         message, status = f"Model `{model_name}` not found.", 404
         return aiohttp.web.json_response(_make_error(message, status=status), status=status)
 
+    # release models and data held by the (still loaded) extension module
+    services_module.clear_model_pool()  # type: ignore
+    services_module.clear_data_cache()  # type: ignore
+
     # delete the directory in which the model and fits are stored
     httpstan.cache.delete_model_directory(model_name)
 
@@ -245,9 +334,7 @@ async def handle_show_params(request: aiohttp.web.Request) -> aiohttp.web.Respon
           schema: Status
 
     """
-    args = cast(dict, await webargs.aiohttpparser.parser.parse(schemas.ShowParamsRequest(), request))
     model_name = f'models/{request.match_info["model_id"]}'
-    data = args["data"]
 
     try:
         services_module = httpstan.models.import_services_extension_module(model_name)
@@ -255,20 +342,23 @@ async def handle_show_params(request: aiohttp.web.Request) -> aiohttp.web.Respon
         message, status = f"Model `{model_name}` not found.", 404
         return aiohttp.web.json_response(_make_error(message, status=status), status=status)
 
+    args = await _parse_args(request, schemas.ShowParamsRequest(), services_module, ("data",))
+    data = args["data"]
+
     # ``get_param_names`` and ``get_dims`` are defined in ``stan_services.cpp``.
     # Apart from converting C++ types into corresponding Python types, they do no processing of the
     # output of ``get_param_names`` and ``get_dims``.
     # Ignoring types due to the difficulty of referring to an extension module
     # which is compiled during run time.
     try:
-        param_names = services_module.get_param_names(data)  # type: ignore
+        param_names = await _call(services_module.get_param_names, data)  # type: ignore
     except Exception as exc:
         # e.g., "N is -5, but must be greater than or equal to 0"
         message, status = f"Error calling get_param_names: `{exc}`", 400
         logger.critical(message)
         return aiohttp.web.json_response(_make_error(message, status=status), status=status)
-    dims = services_module.get_dims(data)  # type: ignore
-    constrained_param_names = services_module.constrained_param_names(data)  # type: ignore
+    dims = await _call(services_module.get_dims, data)  # type: ignore
+    constrained_param_names = await _call(services_module.constrained_param_names, data)  # type: ignore
     params = []
     for name, dims_ in zip(param_names, dims):
         constrained_names = tuple(filter(lambda s: re.match(fr"^{name}\.\S+|^{name}\Z", s), constrained_param_names))
@@ -336,16 +426,23 @@ async def handle_create_fit(request: aiohttp.web.Request) -> aiohttp.web.Respons
           schema: Status
     """
     model_name = f'models/{request.match_info["model_id"]}'
-    args = cast(dict, await webargs.aiohttpparser.parser.parse(schemas.CreateFitRequest(), request))
 
     try:
-        httpstan.models.import_services_extension_module(model_name)
+        services_module = httpstan.models.import_services_extension_module(model_name)
     except KeyError:  # pragma: no cover
         message, status = f"Model `{model_name}` not found.", 404
         return aiohttp.web.json_response(_make_error(message, status=status), status=status)
 
+    args = await _parse_args(request, schemas.CreateFitRequest(), services_module, ("data", "init"))
+
     function = args.pop("function")
-    name = httpstan.fits.calculate_fit_name(function, model_name, args)
+    # the fit name depends on the values in the data, not on how they are encoded
+    try:
+        digests = {key: await _call(services_module.canonical_data_digest, args[key]) for key in ("data", "init")}
+    except Exception as exc:
+        message, status = f"Error reading data: `{exc}`", 400
+        return aiohttp.web.json_response(_make_error(message, status=status), status=status)
+    name = httpstan.fits.calculate_fit_name(function, model_name, {**args, **digests})
     try:
         httpstan.cache.load_fit(name)
     except KeyError:
@@ -389,7 +486,11 @@ async def handle_create_fit(request: aiohttp.web.Request) -> aiohttp.web.Respons
             operation["result"] = _make_error(message, status=status)
             # Delete messages associated with the fit. If initialization
             # fails, for example, messages will exist on disk. Remove them.
-            httpstan.cache.delete_fit(operation["metadata"]["fit"]["name"])
+            try:
+                httpstan.cache.delete_fit(operation["metadata"]["fit"]["name"])
+            except FileNotFoundError:
+                # the call failed before the fit was written
+                pass
         else:
             logger.info(f"Operation `{operation['name']}` finished.")
             operation["result"] = schemas.Fit().load(operation["metadata"]["fit"])
@@ -431,6 +532,7 @@ async def handle_get_fit(request: aiohttp.web.Request) -> aiohttp.web.Response:
         - application/json
       produces:
         - text/plain
+        - application/octet-stream
       parameters:
         - name: model_id
           in: path
@@ -444,7 +546,15 @@ async def handle_get_fit(request: aiohttp.web.Request) -> aiohttp.web.Response:
           type: string
       responses:
         "200":
-          description: Newline-delimited JSON-encoded messages from Stan. Includes draws.
+          description: >-
+            Newline-delimited JSON-encoded messages from Stan. Includes draws.
+            If the fit was created with ``message_version`` 2, each draw is a JSON
+            array of values named by the preceding message with a ``fields`` member.
+            If the fit was created with ``message_version`` 3, draws are in binary
+            frames of consecutive draws and the content type is ``application/octet-stream``.
+            If the fit was created with ``significant_digits``, values in draws
+            have at most that many significant digits. If the fit was created
+            with ``include`` or ``exclude``, draws only have the selected columns.
         "404":
           description: Fit not found.
           schema: Status
@@ -457,11 +567,122 @@ async def handle_get_fit(request: aiohttp.web.Request) -> aiohttp.web.Response:
     except KeyError:  # pragma: no cover
         message, status = f"Fit `{fit_name}` not found.", 404
         return aiohttp.web.json_response(_make_error(message, status=status), status=status)
-    fit_bytes = lz4.frame.decompress(fit_bytes_lz4)
-    assert isinstance(fit_bytes, bytes)
+    fit_bytes = httpstan.fits.decompress(fit_bytes_lz4)
+    # binary frames (message version 3) start with a byte which never occurs in UTF-8 encoded text
+    if b"\xff" in fit_bytes:
+        return aiohttp.web.Response(body=fit_bytes, content_type="application/octet-stream")
     return aiohttp.web.Response(body=fit_bytes, content_type="text/plain", charset="utf-8")
 
 
+async def handle_get_fit_summary(request: aiohttp.web.Request) -> aiohttp.web.Response:
+    """Get summary statistics of the draws in a fit.
+
+    ---
+    get:
+      summary: Get summary statistics of the draws in a fit.
+      description: >-
+        Mean, variance, minimum, maximum and 5%, 50% and 95% quantiles of
+        each parameter, computed by the sample writer as draws are written.
+        Quantiles are estimated from t-digests. The effective sample size is
+        estimated from means of blocks of draws. Warmup draws are excluded.
+        If the fit was created with ``target_ess`` and sampling ended early,
+        ``truncated`` is true. The draws themselves are not read.
+      produces:
+        - application/json
+      parameters:
+        - name: model_id
+          in: path
+          description: ID of Stan model associated with the fit.
+          required: true
+          type: string
+        - name: fit_id
+          in: path
+          description: ID of fit.
+          required: true
+          type: string
+      responses:
+        "200":
+          description: Summary of the draws.
+          schema: FitSummary
+        "404":
+          description: Fit not found, or fit has no summary.
+          schema: Status
+    """
+    model_name = f"models/{request.match_info['model_id']}"
+    fit_name = f"{model_name}/fits/{request.match_info['fit_id']}"
+
+    try:
+        summary_bytes = httpstan.cache.load_fit_summary(fit_name)
+    except KeyError:
+        message, status = f"Summary of fit `{fit_name}` not found.", 404
+        return aiohttp.web.json_response(_make_error(message, status=status), status=status)
+    return aiohttp.web.Response(body=summary_bytes, content_type="application/json")
+
+
+async def handle_show_summary(request: aiohttp.web.Request) -> aiohttp.web.Response:
+    """Get summary statistics of the draws in several fits.
+
+    ---
+    post:
+      summary: Get summary statistics of the draws in several fits.
+      description: >-
+        Merge the summaries of several fits of a model, e.g., one for each
+        chain, as if their draws were in one fit. Quantiles are estimated
+        from the combined t-digests of the fits. Each fit is taken to be a
+        chain for the convergence diagnostics, split-R-hat and the effective
+        sample size, which are estimated from means of blocks of draws. The
+        draws themselves are not read. The fits must have been made with the
+        same function, data and sampler arguments; their seeds, initial values
+        and numbers of draws may differ.
+      consumes:
+        - application/json
+      produces:
+        - application/json
+      parameters:
+        - name: model_id
+          in: path
+          description: ID of Stan model associated with the fits.
+          required: true
+          type: string
+        - in: body
+          name: body
+          description: IDs of fits and probabilities of the quantiles.
+          required: true
+          schema: ShowSummaryRequest
+      responses:
+        "200":
+          description: Summary of the draws in the fits.
+          schema: FitSummary
+        "400":
+          description: >-
+            Fits do not have the same parameters, or were made with different
+            functions, data or sampler arguments.
+          schema: Status
+        "404":
+          description: Fit not found, or fit has no summary.
+          schema: Status
+    """
+    model_name = f"models/{request.match_info['model_id']}"
+    args = cast(dict, await webargs.aiohttpparser.parser.parse(schemas.ShowSummaryRequest(), request))
+
+    summaries = []
+    for fit_id in args["fits"]:
+        fit_name = f"{model_name}/fits/{fit_id}"
+        try:
+            summaries.append(httpstan.cache.load_fit_sketch(fit_name))
+        except KeyError:
+            message, status = f"Summary of fit `{fit_name}` not found.", 404
+            return aiohttp.web.json_response(_make_error(message, status=status), status=status)
+    try:
+        summary = await asyncio.get_running_loop().run_in_executor(
+            executor, httpstan.summaries.merge, summaries, args["probabilities"]
+        )
+    except ValueError as exc:
+        message, status = str(exc), 400
+        return aiohttp.web.json_response(_make_error(message, status=status), status=status)
+    return aiohttp.web.json_response(summary)
+
+
 async def handle_delete_fit(request: aiohttp.web.Request) -> aiohttp.web.Response:
     """Delete a fit.
 
@@ -571,8 +792,10 @@ async def handle_log_prob(request: aiohttp.web.Request) -> aiohttp.web.Response:
         Returns the output of Stan C++ ``log_prob`` model class method.
       consumes:
         - application/json
+        - application/octet-stream
       produces:
         - application/json
+        - application/octet-stream
       parameters:
         - name: model_id
           in: path
@@ -616,25 +839,114 @@ async def handle_log_prob(request: aiohttp.web.Request) -> aiohttp.web.Response:
           description: Model not found.
           schema: Status
     """
-    args = cast(dict, await webargs.aiohttpparser.parser.parse(schemas.ShowLogProbRequest(), request))
     model_name = f'models/{request.match_info["model_id"]}'
+
+    try:
+        services_module = httpstan.models.import_services_extension_module(model_name)
+    except KeyError:
+        message, status = f"Model `{model_name}` not found.", 404
+        return aiohttp.web.json_response(_make_error(message, status=status), status=status)
+
+    args = await _parse_args(request, schemas.ShowLogProbRequest(), services_module, ("data",))
     data = args["data"]
     unconstrained_parameters = args["unconstrained_parameters"]
     adjust_transform = args["adjust_transform"]
 
+    try:
+        lp = await _call(services_module.log_prob, data, unconstrained_parameters, adjust_transform)  # type: ignore
+    except Exception as exc:
+        message, status = f"Error calling log_prob: `{exc}`", 400
+        logger.critical(message)
+        return aiohttp.web.json_response(_make_error(message, status=status), status=status)
+    return _make_response(request, {"log_prob": lp})
+
+
+async def handle_log_prob_batch(request: aiohttp.web.Request) -> aiohttp.web.Response:
+    """Calculate the log probability of many points.
+
+    ---
+    post:
+      summary: Return the log probability of many unconstrained parameter vectors.
+      description: >-
+        Returns the output of Stan C++ ``log_prob`` model class method for
+        each row of a matrix of unconstrained parameters. The model is
+        constructed once and the rows are evaluated in parallel.
+      consumes:
+        - application/json
+        - application/octet-stream
+      produces:
+        - application/json
+        - application/octet-stream
+      parameters:
+        - name: model_id
+          in: path
+          description: ID of Stan model to use
+          required: true
+          type: string
+        - in: body
+          name: data
+          description: >-
+              Data for the Stan Model.
+          required: true
+          schema: Data
+        - in: body
+          name: unconstrained_parameters
+          description: >-
+              Unconstrained parameters to calculate log probability for, one
+              vector (row) per point.
+          required: true
+          schema:
+            type: array
+            items:
+              type: array
+              items:
+                type: number
+        - in: body
+          name: adjust_transform
+          description: >-
+              Boolean to control whether we apply a Jacobian adjust transform.
+          required: false
+          schema:
+            type: boolean
+      responses:
+        "200":
+          description: Log probability of each vector of unconstrained parameters.
+          schema:
+            type: object
+            properties:
+              log_prob:
+                type: array
+                items:
+                  type: number
+        "400":
+          description: Error associated with request.
+          schema: Status
+        "404":
+          description: Model not found.
+          schema: Status
+    """
+    model_name = f'models/{request.match_info["model_id"]}'
+
     try:
         services_module = httpstan.models.import_services_extension_module(model_name)
     except KeyError:
         message, status = f"Model `{model_name}` not found.", 404
         return aiohttp.web.json_response(_make_error(message, status=status), status=status)
 
+    args = await _parse_args(request, schemas.ShowLogProbBatchRequest(), services_module, ("data",))
+    data = args["data"]
+    unconstrained_parameters = args["unconstrained_parameters"]
+    adjust_transform = args["adjust_transform"]
+
     try:
-        lp = services_module.log_prob(data, unconstrained_parameters, adjust_transform)  # type: ignore
+        lp = await _call(
+            services_module.log_prob_batch, data, unconstrained_parameters, adjust_transform  # type: ignore
+        )
     except Exception as exc:
-        message, status = f"Error calling log_prob: `{exc}`", 400
+        message, status = f"Error calling log_prob_batch: `{exc}`", 400
         logger.critical(message)
         return aiohttp.web.json_response(_make_error(message, status=status), status=status)
-    return aiohttp.web.json_response({"log_prob": lp}, status=200)
+    return _make_response(request, {"log_prob": lp})
 
 
 async def handle_log_prob_grad(request: aiohttp.web.Request) -> aiohttp.web.Response:
@@ -647,8 +959,10 @@ async def handle_log_prob_grad(request: aiohttp.web.Request) -> aiohttp.web.Resp
         Returns the output of Stan C++ `stan::model::log_prob_grad`.
       consumes:
         - application/json
+        - application/octet-stream
       produces:
         - application/json
+        - application/octet-stream
       parameters:
         - name: model_id
           in: path
@@ -694,25 +1008,319 @@ async def handle_log_prob_grad(request: aiohttp.web.Request) -> aiohttp.web.Resp
           description: Model not found.
           schema: Status
     """
-    args = cast(dict, await webargs.aiohttpparser.parser.parse(schemas.ShowLogProbGradRequest(), request))
     model_name = f'models/{request.match_info["model_id"]}'
+
+    try:
+        services_module = httpstan.models.import_services_extension_module(model_name)
+    except KeyError:
+        message, status = f"Model `{model_name}` not found.", 404
+        return aiohttp.web.json_response(_make_error(message, status=status), status=status)
+
+    args = await _parse_args(request, schemas.ShowLogProbGradRequest(), services_module, ("data",))
+    data = args["data"]
+    unconstrained_parameters = args["unconstrained_parameters"]
+    adjust_transform = args["adjust_transform"]
+
+    try:
+        gradient = await _call(
+            services_module.log_prob_grad, data, unconstrained_parameters, adjust_transform  # type: ignore
+        )
+    except Exception as exc:
+        message, status = f"Error calling log_prob_grad: `{exc}`", 400
+        logger.critical(message)
+        return aiohttp.web.json_response(_make_error(message, status=status), status=status)
+    return _make_response(request, {"log_prob_grad": gradient})
+
+
+async def handle_log_prob_grad_batch(request: aiohttp.web.Request) -> aiohttp.web.Response:
+    """Calculate the log probability and its gradient at many points.
+
+    ---
+    post:
+      summary: Return the log probability and its gradient for many unconstrained parameter vectors.
+      description: >-
+        Returns the output of Stan C++ ``stan::model::log_prob_grad`` for each
+        row of a matrix of unconstrained parameters. The model is constructed
+        once and the rows are evaluated in parallel.
+      consumes:
+        - application/json
+        - application/octet-stream
+      produces:
+        - application/json
+        - application/octet-stream
+      parameters:
+        - name: model_id
+          in: path
+          description: ID of Stan model to use
+          required: true
+          type: string
+        - in: body
+          name: data
+          description: >-
+              Data for the Stan Model.
+          required: true
+          schema: Data
+        - in: body
+          name: unconstrained_parameters
+          description: >-
+              Unconstrained parameters to calculate the gradient for, one
+              vector (row) per point.
+          required: true
+          schema:
+            type: array
+            items:
+              type: array
+              items:
+                type: number
+        - in: body
+          name: adjust_transform
+          description: >-
+              Boolean to control whether we apply a Jacobian adjust transform.
+          required: false
+          schema:
+            type: boolean
+      responses:
+        "200":
+          description: >-
+            Log probability and gradient of the log probability of each vector
+            of unconstrained parameters.
+          schema:
+            type: object
+            properties:
+              log_prob:
+                type: array
+                items:
+                  type: number
+              log_prob_grad:
+                type: array
+                items:
+                  type: array
+                  items:
+                    type: number
+        "400":
+          description: Error associated with request.
+          schema: Status
+        "404":
+          description: Model not found.
+          schema: Status
+    """
+    model_name = f'models/{request.match_info["model_id"]}'
+
+    try:
+        services_module = httpstan.models.import_services_extension_module(model_name)
+    except KeyError:
+        message, status = f"Model `{model_name}` not found.", 404
+        return aiohttp.web.json_response(_make_error(message, status=status), status=status)
+
+    args = await _parse_args(request, schemas.ShowLogProbGradBatchRequest(), services_module, ("data",))
+    data = args["data"]
+    unconstrained_parameters = args["unconstrained_parameters"]
+    adjust_transform = args["adjust_transform"]
+
+    try:
+        lp, gradient = await _call(
+            services_module.log_prob_grad_batch, data, unconstrained_parameters, adjust_transform  # type: ignore
+        )
+    except Exception as exc:
+        message, status = f"Error calling log_prob_grad_batch: `{exc}`", 400
+        logger.critical(message)
+        return aiohttp.web.json_response(_make_error(message, status=status), status=status)
+    return _make_response(request, {"log_prob": lp, "log_prob_grad": gradient})
+
+
+async def handle_hessian(request: aiohttp.web.Request) -> aiohttp.web.Response:
+    """Calculate the Hessian of the log probability.
+
+    ---
+    post:
+      summary: Return the Hessian of the log probability of the unconstrained parameters.
+      description: >-
+        Returns the log probability, its gradient and its Hessian, calculated
+        using nested forward-over-reverse autodiff.
+      consumes:
+        - application/json
+        - application/octet-stream
+      produces:
+        - application/json
+        - application/octet-stream
+      parameters:
+        - name: model_id
+          in: path
+          description: ID of Stan model to use
+          required: true
+          type: string
+        - in: body
+          name: data
+          description: >-
+              Data for the Stan Model.
+          required: true
+          schema: Data
+        - in: body
+          name: unconstrained_parameters
+          description: >-
+              Unconstrained parameters to calculate the Hessian for.
+          required: true
+          schema:
+            type: array
+            items:
+              type: number
+        - in: body
+          name: adjust_transform
+          description: >-
+              Boolean to control whether we apply a Jacobian adjust transform.
+          required: false
+          schema:
+            type: boolean
+      responses:
+        "200":
+          description: >-
+            Log probability of the unconstrained parameters, its gradient and
+            its Hessian (a list of rows).
+          schema:
+            type: object
+            properties:
+              log_prob:
+                type: number
+              log_prob_grad:
+                type: array
+                items:
+                  type: number
+              hessian:
+                type: array
+                items:
+                  type: array
+                  items:
+                    type: number
+        "400":
+          description: Error associated with request.
+          schema: Status
+        "404":
+          description: Model not found.
+          schema: Status
+    """
+    model_name = f'models/{request.match_info["model_id"]}'
+
+    try:
+        services_module = httpstan.models.import_services_extension_module(model_name)
+    except KeyError:
+        message, status = f"Model `{model_name}` not found.", 404
+        return aiohttp.web.json_response(_make_error(message, status=status), status=status)
+
+    args = await _parse_args(request, schemas.ShowHessianRequest(), services_module, ("data",))
     data = args["data"]
     unconstrained_parameters = args["unconstrained_parameters"]
     adjust_transform = args["adjust_transform"]
 
+    try:
+        lp, gradient, hessian = await _call(
+            services_module.hessian, data, unconstrained_parameters, adjust_transform  # type: ignore
+        )
+    except Exception as exc:
+        message, status = f"Error calling hessian: `{exc}`", 400
+        logger.critical(message)
+        return aiohttp.web.json_response(_make_error(message, status=status), status=status)
+    return _make_response(request, {"log_prob": lp, "log_prob_grad": gradient, "hessian": hessian})
+
+
+async def handle_hessian_vector_product(request: aiohttp.web.Request) -> aiohttp.web.Response:
+    """Calculate the product of the Hessian of the log probability and a vector.
+
+    ---
+    post:
+      summary: Return the product of the Hessian of the log probability and a vector.
+      description: >-
+        Returns the log probability and the product of its Hessian and a
+        vector, calculated using nested forward-over-reverse autodiff without
+        forming the Hessian.
+      consumes:
+        - application/json
+        - application/octet-stream
+      produces:
+        - application/json
+        - application/octet-stream
+      parameters:
+        - name: model_id
+          in: path
+          description: ID of Stan model to use
+          required: true
+          type: string
+        - in: body
+          name: data
+          description: >-
+              Data for the Stan Model.
+          required: true
+          schema: Data
+        - in: body
+          name: unconstrained_parameters
+          description: >-
+              Unconstrained parameters at which the Hessian is evaluated.
+          required: true
+          schema:
+            type: array
+            items:
+              type: number
+        - in: body
+          name: vector
+          description: >-
+              Vector by which the Hessian is multiplied.
+          required: true
+          schema:
+            type: array
+            items:
+              type: number
+        - in: body
+          name: adjust_transform
+          description: >-
+              Boolean to control whether we apply a Jacobian adjust transform.
+          required: false
+          schema:
+            type: boolean
+      responses:
+        "200":
+          description: Log probability of the unconstrained parameters and the Hessian-vector product.
+          schema:
+            type: object
+            properties:
+              log_prob:
+                type: number
+              hessian_vector_product:
+                type: array
+                items:
+                  type: number
+        "400":
+          description: Error associated with request.
+          schema: Status
+        "404":
+          description: Model not found.
+          schema: Status
+    """
+    model_name = f'models/{request.match_info["model_id"]}'
+
     try:
         services_module = httpstan.models.import_services_extension_module(model_name)
     except KeyError:
         message, status = f"Model `{model_name}` not found.", 404
         return aiohttp.web.json_response(_make_error(message, status=status), status=status)
 
+    args = await _parse_args(request, schemas.ShowHessianVectorProductRequest(), services_module, ("data",))
+    data = args["data"]
+    unconstrained_parameters = args["unconstrained_parameters"]
+    vector = args["vector"]
+    adjust_transform = args["adjust_transform"]
+
     try:
-        gradient = services_module.log_prob_grad(data, unconstrained_parameters, adjust_transform)  # type: ignore
+        lp, product = await _call(
+            services_module.hessian_vector_product,  # type: ignore
+            data,
+            unconstrained_parameters,
+            vector,
+            adjust_transform,
+        )
     except Exception as exc:
-        message, status = f"Error calling log_prob_grad: `{exc}`", 400
+        message, status = f"Error calling hessian_vector_product: `{exc}`", 400
         logger.critical(message)
         return aiohttp.web.json_response(_make_error(message, status=status), status=status)
-    return aiohttp.web.json_response({"log_prob_grad": gradient}, status=200)
+    return _make_response(request, {"log_prob": lp, "hessian_vector_product": product})
 
 
 async def handle_write_array(request: aiohttp.web.Request) -> aiohttp.web.Response:
@@ -731,8 +1339,10 @@ async def handle_write_array(request: aiohttp.web.Request) -> aiohttp.web.Respon
         Returns the output of Stan C++ ``write_array`` model class method.
       consumes:
         - application/json
+        - application/octet-stream
       produces:
         - application/json
+        - application/octet-stream
       parameters:
         - name: model_id
           in: path
@@ -787,12 +1397,7 @@ async def handle_write_array(request: aiohttp.web.Request) -> aiohttp.web.Respon
           description: Model not found.
           schema: Status
     """
-    args = cast(dict, await webargs.aiohttpparser.parser.parse(schemas.ShowWriteArrayRequest(), request))
     model_name = f'models/{request.match_info["model_id"]}'
-    data = args["data"]
-    unconstrained_parameters = args["unconstrained_parameters"]
-    include_tparams = args["include_tparams"]
-    include_gqs = args["include_gqs"]
 
     try:
         services_module = httpstan.models.import_services_extension_module(model_name)
@@ -800,13 +1405,21 @@ async def handle_write_array(request: aiohttp.web.Request) -> aiohttp.web.Respon
         message, status = f"Model `{model_name}` not found.", 404
         return aiohttp.web.json_response(_make_error(message, status=status), status=status)
 
+    args = await _parse_args(request, schemas.ShowWriteArrayRequest(), services_module, ("data",))
+    data = args["data"]
+    unconstrained_parameters = args["unconstrained_parameters"]
+    include_tparams = args["include_tparams"]
+    include_gqs = args["include_gqs"]
+
     try:
-        params_r_constrained = services_module.write_array(data, unconstrained_parameters, include_tparams, include_gqs)  # type: ignore
+        params_r_constrained = await _call(
+            services_module.write_array, data, unconstrained_parameters, include_tparams, include_gqs  # type: ignore
+        )
     except Exception as exc:
         message, status = f"Error calling write_array: `{exc}`", 400
         logger.critical(message)
         return aiohttp.web.json_response(_make_error(message, status=status), status=status)
-    return aiohttp.web.json_response({"params_r_constrained": params_r_constrained}, status=200)
+    return _make_response(request, {"params_r_constrained": params_r_constrained})
 
 
 async def handle_transform_inits(request: aiohttp.web.Request) -> aiohttp.web.Response:
@@ -825,8 +1438,10 @@ async def handle_transform_inits(request: aiohttp.web.Request) -> aiohttp.web.Re
         Returns the output of Stan C++ ``transform_inits`` model class method.
       consumes:
         - application/json
+        - application/octet-stream
       produces:
         - application/json
+        - application/octet-stream
       parameters:
         - name: model_id
           in: path
@@ -863,10 +1478,7 @@ async def handle_transform_inits(request: aiohttp.web.Request) -> aiohttp.web.Re
           description: Model not found.
           schema: Status
     """
-    args = cast(dict, await webargs.aiohttpparser.parser.parse(schemas.ShowTransformInitsRequest(), request))
     model_name = f'models/{request.match_info["model_id"]}'
-    data = args["data"]
-    constrained_parameters = args["constrained_parameters"]
 
     try:
         services_module = httpstan.models.import_services_extension_module(model_name)
@@ -874,10 +1486,18 @@ async def handle_transform_inits(request: aiohttp.web.Request) -> aiohttp.web.Re
         message, status = f"Model `{model_name}` not found.", 404
         return aiohttp.web.json_response(_make_error(message, status=status), status=status)
 
+    args = await _parse_args(
+        request, schemas.ShowTransformInitsRequest(), services_module, ("data", "constrained_parameters")
+    )
+    data = args["data"]
+    constrained_parameters = args["constrained_parameters"]
+
     try:
-        params_r_unconstrained = services_module.transform_inits(data, constrained_parameters)  # type: ignore
+        params_r_unconstrained = await _call(
+            services_module.transform_inits, data, constrained_parameters  # type: ignore
+        )
     except Exception as exc:
         message, status = f"Error calling write_array: `{exc}`", 400
         logger.critical(message)
         return aiohttp.web.json_response(_make_error(message, status=status), status=status)
-    return aiohttp.web.json_response({"params_r_unconstrained": params_r_unconstrained}, status=200)
+    return _make_response(request, {"params_r_unconstrained": params_r_unconstrained})
@@ -0,0 +1,47 @@
+#ifndef HTTPSTAN_WIRE_HPP
+#define HTTPSTAN_WIRE_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace httpstan {
+namespace wire {
+
+/**
+ * Encode a message in the binary wire format described in ``httpstan.wire``.
+ * Arrays are one-dimensional.
+ *
+ * @param[in] header JSON-encoded object
+ * @param[in] arrays names and values of the arrays
+ * @return encoded message
+ */
+inline std::string encode(const std::string &header,
+                          const std::vector<std::pair<std::string, std::vector<double>>> &arrays) {
+  std::string message("HSTN");
+  auto append_uint = [&message](uint64_t value, std::size_t size) {
+    for (std::size_t i = 0; i < size; ++i)
+      message.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+  };
+  append_uint(header.size(), 4);
+  message += header;
+  for (const auto &array : arrays) {
+    append_uint(array.first.size(), 4);
+    message += array.first;
+    append_uint(1, 4);
+    append_uint(array.second.size(), 8);
+    message.append((8 - message.size() % 8) % 8, '\0');
+    // IEEE 754 doubles in host byte order, which is little-endian on all platforms httpstan supports
+    const std::size_t offset = message.size();
+    message.resize(offset + array.second.size() * sizeof(double));
+    if (!array.second.empty())
+      std::memcpy(&message[offset], array.second.data(), array.second.size() * sizeof(double));
+  }
+  return message;
+}
+
+} // namespace wire
+} // namespace httpstan
+#endif // HTTPSTAN_WIRE_HPP
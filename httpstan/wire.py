@@ -0,0 +1,124 @@
+"""Binary wire format for requests and responses holding arrays of numbers.
+
+Endpoints which take or return vectors of parameters (e.g., ``log_prob_grad``)
+accept and produce this format as an alternative to JSON. Arrays are sent as
+raw little-endian float64 values, avoiding formatting and parsing numbers as
+text. Decoded arrays are views of the message; no Python ``float`` or ``list``
+objects are created.
+
+A message is, in order:
+
+- the four bytes ``HSTN``;
+- the length of the header, a little-endian uint32;
+- the header, a UTF-8 JSON-encoded object;
+- zero or more array blocks, until the end of the message.
+
+The header holds all arguments which are not arrays (e.g., ``data`` or
+``adjust_transform``) in the same form as in a JSON-encoded request. An array
+block is, in order:
+
+- the length of the name of the array, a little-endian uint32;
+- the name, UTF-8 encoded;
+- the number of dimensions, a little-endian uint32;
+- each dimension, a little-endian uint64;
+- zero bytes, up to the next offset (from the start of the message) which is a multiple of 8;
+- the values, in row-major (C) order, as little-endian float64.
+"""
+import struct
+from typing import Dict, Mapping, Tuple
+
+import numpy as np
+
+MEDIA_TYPE = "application/octet-stream"
+MAGIC = b"HSTN"
+
+_uint32 = struct.Struct("<I")
+_float64 = np.dtype("<f8")
+
+
+def encode(header: bytes, arrays: Mapping[str, np.ndarray]) -> bytes:
+    """Encode a message.
+
+    Arguments:
+        header: JSON-encoded object.
+        arrays: Arrays of numbers, keyed by name.
+
+    Returns:
+        bytes: Encoded message.
+
+    """
+    parts = [MAGIC, _uint32.pack(len(header)), header]
+    length = len(MAGIC) + _uint32.size + len(header)
+    for name, array in arrays.items():
+        array = np.ascontiguousarray(array, dtype=_float64)
+        name_bytes = name.encode()
+        block_header = b"".join(
+            [
+                _uint32.pack(len(name_bytes)),
+                name_bytes,
+                _uint32.pack(array.ndim),
+                struct.pack(f"<{array.ndim}Q", *array.shape),
+            ]
+        )
+        length += len(block_header)
+        padding = -length % 8
+        parts.extend([block_header, bytes(padding), array.tobytes()])
+        length += padding + array.nbytes
+    return b"".join(parts)
+
+
+def decode(message: bytes) -> Tuple[bytes, Dict[str, np.ndarray]]:
+    """Decode a message.
+
+    Arrays are read-only views of ``message``.
+
+    Arguments:
+        message: Encoded message.
+
+    Returns:
+        tuple: JSON-encoded header and arrays keyed by name.
+
+    Raises:
+        ValueError: ``message`` is not a valid message.
+
+    """
+    view = memoryview(message)
+    if bytes(view[: len(MAGIC)]) != MAGIC:
+        raise ValueError("Message does not start with the expected magic bytes.")
+    offset = len(MAGIC)
+    (header_length,) = _unpack_from(_uint32, view, offset)
+    offset += _uint32.size
+    if len(view) - offset < header_length:
+        raise ValueError("Message is too short to hold its header.")
+    header = bytes(view[offset : offset + header_length])
+    offset += header_length
+
+    arrays = {}
+    while offset < len(view):
+        (name_length,) = _unpack_from(_uint32, view, offset)
+        offset += _uint32.size
+        try:
+            name = bytes(view[offset : offset + name_length]).decode()
+        except UnicodeDecodeError:
+            raise ValueError("Array name is not valid UTF-8.")
+        offset += name_length
+        if name in arrays:
+            raise ValueError(f"Message holds more than one array named `{name}`.")
+        (ndim,) = _unpack_from(_uint32, view, offset)
+        offset += _uint32.size
+        shape = _unpack_from(struct.Struct(f"<{ndim}Q"), view, offset)
+        offset += 8 * ndim
+        offset += -offset % 8
+        size = int(np.prod(shape, dtype=np.uint64))
+        if len(view) - offset < size * _float64.itemsize:
+            raise ValueError(f"Message is too short to hold array `{name}`.")
+        arrays[name] = np.frombuffer(view, dtype=_float64, count=size, offset=offset).reshape(shape)
+        offset += size * _float64.itemsize
+    return header, arrays
+
+
+def _unpack_from(format: struct.Struct, view: memoryview, offset: int) -> tuple:
+    try:
+        return format.unpack_from(view, offset)
+    except struct.error:
+        raise ValueError("Message is truncated.")
@@ -0,0 +1,87 @@
+"""Benchmark reading NumPy arrays into the data of a model.
+
+Contiguous float64, int32 and int64 arrays are copied straight from their
+buffers. Other values go through ``httpstan.utils._split_data`` and are copied
+one element at a time. This script times both paths on the same values. The
+slow path is forced by passing a strided, non-contiguous view of each array.
+
+Both paths are timed through ``canonical_data_digest``, which reads ``data``
+into a var_context and hashes it. Hashing costs the same on both paths. The
+time spent in ``_split_data`` alone is also reported. The model is built (and
+cached) if necessary.
+"""
+import argparse
+import asyncio
+import time
+import typing
+
+import numpy as np
+
+import httpstan.models
+import httpstan.utils
+
+PROGRAM_CODE = """
+data {
+  int N;
+  vector[N] x;
+  int k[N];
+}
+parameters {
+  real mu;
+}
+model {
+  x ~ normal(mu, 1);
+}
+"""
+
+parser = argparse.ArgumentParser(description="Benchmark reading NumPy arrays into a var_context.")
+parser.add_argument("--max-num-values", type=int, default=10 ** 7, help="Largest array size (default: 10^7).")
+parser.add_argument("--repeat", type=int, default=3, help="Timings per array size, best is reported (default: 3).")
+
+
+def best_time(function: typing.Callable[[], object], repeat: int) -> float:
+    """Return the shortest of ``repeat`` timings of ``function``."""
+    timings = []
+    for _ in range(repeat):
+        start = time.perf_counter()
+        function()
+        timings.append(time.perf_counter() - start)
+    return min(timings)
+
+
+def strided(array: np.ndarray) -> np.ndarray:
+    """Return a non-contiguous view with the values of the one-dimensional ``array``."""
+    view = np.empty(2 * len(array), dtype=array.dtype)[::2]
+    view[:] = array
+    return view
+
+
+def main() -> None:
+    args = parser.parse_args()
+    model_name = httpstan.models.calculate_model_name(PROGRAM_CODE)
+    try:
+        module = httpstan.models.import_services_extension_module(model_name)
+    except KeyError:
+        asyncio.get_event_loop().run_until_complete(httpstan.models.build_services_extension_module(PROGRAM_CODE))
+        module = httpstan.models.import_services_extension_module(model_name)
+
+    rng = np.random.RandomState(1)
+    print(f"{'values':>10} {'buffer (s)':>12} {'split (s)':>12} {'_split_data (s)':>16} {'speedup':>8}")
+    num_values = 10 ** 3
+    while num_values <= args.max_num_values:
+        x = rng.normal(size=num_values)
+        k = rng.randint(0, 100, size=num_values).astype(np.int64)
+        contiguous = {"N": num_values, "x": x, "k": k}
+        noncontiguous = {"N": num_values, "x": strided(x), "k": strided(k)}
+        assert not noncontiguous["x"].flags.contiguous and not noncontiguous["k"].flags.contiguous
+        assert module.canonical_data_digest(contiguous) == module.canonical_data_digest(noncontiguous)
+
+        buffer = best_time(lambda: module.canonical_data_digest(contiguous), args.repeat)  # type: ignore
+        split = best_time(lambda: module.canonical_data_digest(noncontiguous), args.repeat)  # type: ignore
+        split_data = best_time(lambda: httpstan.utils._split_data(noncontiguous), args.repeat)
+        print(f"{num_values:>10} {buffer:12.6f} {split:12.6f} {split_data:16.6f} {split / buffer:8.1f}")
+        num_values *= 10
+
+
+if __name__ == "__main__":
+    main()
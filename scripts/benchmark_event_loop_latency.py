@@ -0,0 +1,110 @@
+"""Benchmark the responsiveness of the event loop while many fits are running.
+
+Starts ``--num-fits`` concurrent calls to ``services_stub.call`` in this
+process's event loop, as the server does, while a ticker coroutine sleeps for
+``--interval`` seconds at a time and records how late it wakes up. Lag is the
+time the event loop spends on other work, such as reading logger messages, or
+polling. Run the script before and after a change to message ingestion to
+compare. The fits are written to the httpstan cache and deleted afterwards.
+"""
+import argparse
+import asyncio
+import statistics
+import time
+import typing
+
+import httpstan.cache
+import httpstan.models
+import httpstan.services_stub as services_stub
+
+PROGRAM_CODE = """
+parameters {
+  real z;
+}
+model {
+  z ~ std_normal();
+}
+"""
+
+parser = argparse.ArgumentParser(description="Benchmark event loop lag while fits are running.")
+parser.add_argument("--num-fits", type=int, default=32, help="Number of concurrent fits (default: 32).")
+parser.add_argument("--num-samples", type=int, default=20_000, help="Draws per fit (default: 20000).")
+parser.add_argument("--refresh", type=int, default=10, help="Draws between progress messages (default: 10).")
+parser.add_argument("--interval", type=float, default=0.005, help="Ticker sleep in seconds (default: 0.005).")
+
+
+async def ticker(interval: float, lags: typing.List[float], stop: asyncio.Event) -> None:
+    """Record how late each `asyncio.sleep(interval)` returns."""
+    while not stop.is_set():
+        start = time.perf_counter()
+        await asyncio.sleep(interval)
+        lags.append(time.perf_counter() - start - interval)
+
+
+async def run(args: argparse.Namespace) -> None:
+    model_name = httpstan.models.calculate_model_name(PROGRAM_CODE)
+    try:
+        httpstan.models.import_services_extension_module(model_name)
+    except KeyError:
+        await httpstan.models.build_services_extension_module(PROGRAM_CODE)
+
+    num_messages = 0
+
+    def logger_callback(message: bytes) -> None:
+        nonlocal num_messages
+        num_messages += 1
+
+    idle_lags: typing.List[float] = []
+    stop = asyncio.Event()
+    idle = asyncio.ensure_future(ticker(args.interval, idle_lags, stop))
+    await asyncio.sleep(1)
+    stop.set()
+    await idle
+
+    lags: typing.List[float] = []
+    stop = asyncio.Event()
+    busy = asyncio.ensure_future(ticker(args.interval, lags, stop))
+    fit_names = [f"{model_name}/fits/benchmark-event-loop-{i}" for i in range(args.num_fits)]
+    start = time.perf_counter()
+    await asyncio.gather(
+        *(
+            services_stub.call(
+                "stan::services::sample::hmc_nuts_diag_e_adapt",
+                model_name,
+                fit_name,
+                logger_callback,
+                data={},
+                init={},
+                random_seed=i,
+                num_samples=args.num_samples,
+                refresh=args.refresh,
+            )
+            for i, fit_name in enumerate(fit_names)
+        )
+    )
+    elapsed = time.perf_counter() - start
+    stop.set()
+    await busy
+    for fit_name in fit_names:
+        httpstan.cache.delete_fit(fit_name)
+
+    print(f"fits: {args.num_fits}, draws per fit: {args.num_samples}, refresh: {args.refresh}")
+    print(f"elapsed (s): {elapsed:.3f}")
+    print(f"logger messages: {num_messages} ({num_messages / elapsed:.0f} per second)")
+    for label, values in (("idle", idle_lags), ("busy", lags)):
+        values = sorted(values)
+        p99 = values[int(0.99 * (len(values) - 1))]
+        print(
+            f"{label} lag (ms): median {1000 * statistics.median(values):.3f}, "
+            f"p99 {1000 * p99:.3f}, max {1000 * values[-1]:.3f}"
+        )
+
+
+def main() -> None:
+    args = parser.parse_args()
+    asyncio.get_event_loop().run_until_complete(run(args))
+    services_stub.executor.shutdown()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,77 @@
+"""Benchmark batched log_prob against repeated calls to log_prob.
+
+Calls the services extension module directly, bypassing HTTP, so the numbers
+measure model evaluation and per-call overhead only. The model is built (and
+cached) if necessary.
+"""
+import argparse
+import asyncio
+import json
+import time
+import typing
+
+import numpy as np
+
+import httpstan.models
+
+PROGRAM_CODE = """
+data {
+  int N;
+  vector[N] y;
+}
+parameters {
+  real mu;
+  real<lower=0> sigma;
+}
+model {
+  y ~ normal(mu, sigma);
+}
+"""
+
+parser = argparse.ArgumentParser(description="Benchmark batched log_prob.")
+parser.add_argument("--max-batch-size", type=int, default=10 ** 5, help="Largest batch size (default: 10^5).")
+parser.add_argument("--num-observations", type=int, default=100, help="Size of the data (default: 100).")
+parser.add_argument("--repeat", type=int, default=3, help="Timings per batch size, best is reported (default: 3).")
+
+
+def best_time(function: typing.Callable[[], object], repeat: int) -> float:
+    """Return the shortest of ``repeat`` timings of ``function``."""
+    timings = []
+    for _ in range(repeat):
+        start = time.perf_counter()
+        function()
+        timings.append(time.perf_counter() - start)
+    return min(timings)
+
+
+def main() -> None:
+    args = parser.parse_args()
+    model_name = httpstan.models.calculate_model_name(PROGRAM_CODE)
+    try:
+        module = httpstan.models.import_services_extension_module(model_name)
+    except KeyError:
+        asyncio.get_event_loop().run_until_complete(httpstan.models.build_services_extension_module(PROGRAM_CODE))
+        module = httpstan.models.import_services_extension_module(model_name)
+
+    rng = np.random.RandomState(1)
+    y = rng.normal(size=args.num_observations)
+    data = json.dumps({"N": len(y), "y": y.tolist()}).encode()
+
+    print(f"{'batch size':>10} {'batch (s)':>12} {'per point (us)':>15} {'loop (s)':>12} {'speedup':>8}")
+    batch_size = 1
+    while batch_size <= args.max_batch_size:
+        points = rng.normal(size=(batch_size, 2))
+        batch = best_time(lambda: module.log_prob_batch(data, points, True), args.repeat)  # type: ignore
+        # repeated single calls are slow, time them for small batches only
+        if batch_size <= 10 ** 4:
+            rows = points.tolist()
+            loop = best_time(lambda: [module.log_prob(data, row, True) for row in rows], args.repeat)  # type: ignore
+            loop_text, speedup_text = f"{loop:12.6f}", f"{loop / batch:8.1f}"
+        else:
+            loop_text, speedup_text = f"{'-':>12}", f"{'-':>8}"
+        print(f"{batch_size:>10} {batch:12.6f} {batch / batch_size * 1e6:15.3f} {loop_text} {speedup_text}")
+        batch_size *= 10
+
+
+if __name__ == "__main__":
+    main()
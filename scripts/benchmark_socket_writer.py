@@ -0,0 +1,125 @@
+"""Benchmark writing draws in the services extension module.
+
+Samples a cheap model in this process, bypassing HTTP and the process pool,
+while a thread reads the messages sent by the logger. The writers write the fit
+to a temporary directory. With ``fixed_param`` almost all of the time is spent
+writing draws. Run the script
+before and after a change to the writers to compare. To count the system calls
+made by the writers, run the script under ``strace -f -c -e trace=write,sendmsg``.
+
+Draws never pass through the socket, which only carries logger messages to the
+server (see ``httpstan/transport.hpp``).
+"""
+import argparse
+import asyncio
+import os
+import selectors
+import socket
+import tempfile
+import threading
+import time
+import typing
+
+import httpstan.models
+import httpstan.services.arguments as arguments
+
+PROGRAM_CODE = """
+data {
+  int K;
+}
+parameters {
+  vector[K] z;
+}
+model {
+  z ~ std_normal();
+}
+"""
+
+parser = argparse.ArgumentParser(description="Benchmark writing draws through the socket writers.")
+parser.add_argument("--function", choices=["fixed_param", "hmc_nuts_diag_e_adapt"], default="fixed_param")
+parser.add_argument("--num-parameters", type=int, default=10, help="Number of parameters (default: 10).")
+parser.add_argument("--num-samples", type=int, default=100_000, help="Number of draws (default: 100000).")
+parser.add_argument("--message-version", type=int, choices=[1, 2, 3], default=1)
+parser.add_argument("--significant-digits", type=int, default=0, help="Digits in draws (default: 0, full precision).")
+
+
+def read_messages(listener: socket.socket, counts: typing.Dict[str, int]) -> None:
+    """Read logger messages until the transport closes its connection."""
+    selector = selectors.DefaultSelector()
+    selector.register(listener, selectors.EVENT_READ)
+    num_open = 0
+    while True:
+        for key, _ in selector.select():
+            sock = typing.cast(socket.socket, key.fileobj)
+            if sock is listener:
+                conn, _ = listener.accept()
+                selector.register(conn, selectors.EVENT_READ)
+                num_open += 1
+                continue
+            chunk = sock.recv(65536)
+            if not chunk:
+                selector.unregister(sock)
+                sock.close()
+                num_open -= 1
+                if num_open == 0:
+                    return
+                continue
+            counts["chunks"] += 1
+            counts["bytes"] += len(chunk)
+
+
+def main() -> None:
+    args = parser.parse_args()
+    model_name = httpstan.models.calculate_model_name(PROGRAM_CODE)
+    try:
+        module = httpstan.models.import_services_extension_module(model_name)
+    except KeyError:
+        asyncio.get_event_loop().run_until_complete(httpstan.models.build_services_extension_module(PROGRAM_CODE))
+        module = httpstan.models.import_services_extension_module(model_name)
+
+    kwargs: typing.Dict[str, typing.Any] = {
+        "data": {"K": args.num_parameters},
+        "init": {},
+        "random_seed": 1,
+        "num_samples": args.num_samples,
+        "refresh": 1000,
+    }
+    for arg in arguments.function_arguments(args.function, module):
+        if arg not in kwargs:
+            kwargs[arg] = arguments.lookup_default(arguments.Method.SAMPLE, arg)
+
+    with tempfile.TemporaryDirectory() as directory:
+        socket_filename = os.path.join(directory, "benchmark.sock")
+        fit_filename = os.path.join(directory, "benchmark.jsonlines.lz4")
+        listener = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        listener.bind(socket_filename)
+        listener.listen(4)
+        counts = {"chunks": 0, "bytes": 0}
+        reader = threading.Thread(target=read_messages, args=(listener, counts))
+        reader.start()
+        start = time.perf_counter()
+        function = getattr(module, f"{args.function}_wrapper")
+        function(
+            socket_filename,
+            fit_filename,
+            message_version=args.message_version,
+            significant_digits=args.significant_digits,
+            **kwargs,
+        )
+        reader.join()
+        elapsed = time.perf_counter() - start
+        fit_size = os.path.getsize(fit_filename)
+        listener.close()
+
+    print(f"function: {args.function}, parameters: {args.num_parameters}, draws: {args.num_samples}")
+    print(f"significant digits: {args.significant_digits or 'full precision'}")
+    print(f"elapsed (s): {elapsed:.3f}")
+    print(f"draws written to the fit per second: {args.num_samples / elapsed:.0f}")
+    print(f"fit size (bytes): {fit_size} ({fit_size / args.num_samples:.1f} per draw)")
+    # only logger messages are sent to the server
+    print(f"logger bytes received: {counts['bytes']}")
+    print(f"logger chunks received: {counts['chunks']}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,113 @@
+"""Benchmark the time the writers spend on each draw.
+
+Calls ``fixed_param_wrapper`` in this process, bypassing HTTP and the process
+pool. ``fixed_param`` does almost nothing but write draws, so the time taken
+per draw is close to the overhead of the sample and diagnostic writers. Each
+configuration is sampled with ``--num-samples`` and with twice as many draws.
+The difference, divided by ``--num-samples``, is reported as the time per draw.
+This removes the costs which do not depend on the number of draws, such as
+building the model.
+
+Run the script before and after a change to the writers (see
+``httpstan/socket_writer.hpp``) to compare. Older wrappers, which sent draws to
+the server instead of writing the fit, are also supported.
+"""
+import argparse
+import asyncio
+import os
+import socket
+import tempfile
+import threading
+import time
+import typing
+
+import httpstan.models
+import httpstan.services.arguments as arguments
+
+PROGRAM_CODE = """
+data {
+  int K;
+}
+parameters {
+  vector[K] z;
+}
+model {
+  z ~ std_normal();
+}
+"""
+
+parser = argparse.ArgumentParser(description="Benchmark the time the writers spend on each draw.")
+parser.add_argument("--num-samples", type=int, default=20_000, help="Number of draws (default: 20000).")
+parser.add_argument(
+    "--num-parameters", type=int, nargs="+", default=[1, 10, 100], help="Numbers of parameters (default: 1 10 100)."
+)
+parser.add_argument("--repeat", type=int, default=3, help="Timings per configuration, best is reported (default: 3).")
+
+
+def drain(listener: socket.socket) -> None:
+    """Accept the connection of the transport and read messages until it is closed."""
+    conn, _ = listener.accept()
+    with conn:
+        while conn.recv(65536):
+            pass
+
+
+def sample_time(function: typing.Callable, directory: str, kwargs: typing.Dict[str, typing.Any]) -> float:
+    """Return the time taken by one call of ``function``, which writes its fit to ``directory``.
+
+    The fit and its sidecars replace those of the previous call.
+    """
+    socket_filename = os.path.join(directory, "benchmark.sock")
+    # wrappers without a ``fit_filename`` argument send draws through the socket
+    filenames = [socket_filename]
+    if "fit_filename" in (function.__doc__ or ""):
+        filenames.append(os.path.join(directory, "benchmark.jsonlines.lz4"))
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as listener:
+        listener.bind(socket_filename)
+        listener.listen(1)
+        reader = threading.Thread(target=drain, args=(listener,))
+        reader.start()
+        start = time.perf_counter()
+        function(*filenames, **kwargs)
+        reader.join()
+        elapsed = time.perf_counter() - start
+    os.unlink(socket_filename)
+    return elapsed
+
+
+def main() -> None:
+    args = parser.parse_args()
+    model_name = httpstan.models.calculate_model_name(PROGRAM_CODE)
+    try:
+        module = httpstan.models.import_services_extension_module(model_name)
+    except KeyError:
+        asyncio.get_event_loop().run_until_complete(httpstan.models.build_services_extension_module(PROGRAM_CODE))
+        module = httpstan.models.import_services_extension_module(model_name)
+    function = module.fixed_param_wrapper  # type: ignore
+
+    print(f"{'parameters':>10} {'message version':>15} {'per draw (us)':>14} {'per value (ns)':>15}")
+    with tempfile.TemporaryDirectory() as directory:
+        for num_parameters in args.num_parameters:
+            for message_version in (1, 2, 3):
+                kwargs: typing.Dict[str, typing.Any] = {
+                    "data": {"K": num_parameters},
+                    "init": {},
+                    "random_seed": 1,
+                    "refresh": 0,
+                    "message_version": message_version,
+                }
+                for arg in arguments.function_arguments("fixed_param", module):
+                    if arg not in kwargs:
+                        kwargs[arg] = arguments.lookup_default(arguments.Method.SAMPLE, arg)
+                timings = {}
+                for num_samples in (args.num_samples, 2 * args.num_samples):
+                    kwargs["num_samples"] = num_samples
+                    timings[num_samples] = min(sample_time(function, directory, kwargs) for _ in range(args.repeat))
+                per_draw = (timings[2 * args.num_samples] - timings[args.num_samples]) / args.num_samples
+                # each draw holds the parameters and the sampler's lp__ and accept_stat__
+                per_value = per_draw / (num_parameters + 2)
+                print(f"{num_parameters:>10} {message_version:>15} {per_draw * 1e6:14.3f} {per_value * 1e9:15.1f}")
+
+
+if __name__ == "__main__":
+    main()
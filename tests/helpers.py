@@ -1,6 +1,7 @@
 """Helper functions for tests."""
 import asyncio
 import json
+import struct
 import typing
 
 import aiohttp
@@ -35,9 +36,42 @@ def decode_messages(fit_bytes: bytes) -> typing.List[typing.Dict]:
 
     """
     messages = []
-    for line in fit_bytes.splitlines():
+    # in versions 2 and 3 of the format, draws are values named by the preceding `fields` message
+    header: typing.Dict = {}
+    headers: typing.Dict[str, typing.Dict] = {}
+    position = 0
+    while position < len(fit_bytes):
+        if fit_bytes[position] == 0xFF:
+            # binary frame, see `httpstan/socket_writer.hpp`
+            _, channel, value_size, _, _, _, num_draws, num_values, length = struct.unpack_from(
+                "<BBBBIIIII", fit_bytes, position
+            )
+            assert value_size in (4, 8) and length == num_draws * num_values * value_size
+            value_format = "d" if value_size == 8 else "f"
+            values = struct.unpack_from(f"<{num_draws * num_values}{value_format}", fit_bytes, position + 24)
+            frame_header = headers[{1: "sample", 2: "diagnostic"}[channel]]
+            for i in range(num_draws):
+                draw = dict(zip(frame_header["fields"], values[i * num_values : (i + 1) * num_values]))
+                messages.append({"version": frame_header["version"], "topic": frame_header["topic"], "values": draw})
+            position += 24 + length
+            continue
+        end = fit_bytes.find(b"\n", position)
+        end = len(fit_bytes) if end == -1 else end
+        line, position = fit_bytes[position:end], end + 1
+        if not line.strip():
+            continue
         payload = json.loads(line)
-        messages.append(schemas.WriterMessage().load(payload))
+        if isinstance(payload, list):
+            assert header, "Draw precedes the names of its values."
+            values = dict(zip(header["fields"], payload))
+            messages.append({"version": header["version"], "topic": header["topic"], "values": values})
+            continue
+        message = schemas.WriterMessage().load(payload)
+        if "field_names" in message:
+            header = {"version": message["version"], "topic": message["topic"], "fields": message["field_names"]}
+            headers[message["topic"]] = header
+            continue
+        messages.append(message)
     return messages
 
 
@@ -121,7 +155,7 @@ async def fit_bytes(api_url: str, fit_name: str) -> bytes:
         fit_url = f"{api_url}/{fit_name}"
         async with session.get(fit_url) as resp:
             assert resp.status == 200
-            assert resp.headers["Content-Type"] == "text/plain; charset=utf-8"
+            assert resp.headers["Content-Type"] in {"text/plain; charset=utf-8", "application/octet-stream"}
             fit_bytes = await resp.read()
     return fit_bytes
 
@@ -0,0 +1,58 @@
+"""Test passing NumPy arrays as data to the services extension module."""
+import typing
+
+import numpy as np
+import pytest
+
+import httpstan.models
+
+import helpers
+
+program_code = """
+    data {
+      int N;
+      int M;
+      matrix[N, M] X;
+      int y[N, M];
+    }
+    parameters {
+      real mu;
+    }
+    model {
+      mu ~ normal(X[1, 2] + y[2, 1], 1);
+    }
+"""
+
+X = [[1.0, 2.0, 3.0], [4.0, 5.0, 6.0]]
+y = [[1, 2, 3], [4, 5, 6]]
+
+
+@pytest.mark.parametrize(
+    "arrays",
+    [
+        {"X": np.array(X), "y": np.array(y)},
+        {"X": np.asfortranarray(X), "y": np.asfortranarray(y, dtype=np.int32)},
+        {"X": np.array(X), "y": np.array(y, dtype=np.int64)},
+        # non-contiguous arrays are handled by the fallback path
+        {"X": np.repeat(np.array(X), 2, axis=1)[:, ::2], "y": np.array(y)},
+    ],
+)
+@pytest.mark.asyncio
+async def test_array_data(arrays: typing.Dict[str, np.ndarray], api_url: str) -> None:
+    """Test that NumPy arrays in C and Fortran order match nested lists."""
+    model_name = await helpers.get_model_name(api_url, program_code)
+    module = httpstan.models.import_services_extension_module(model_name)
+    data_lists = {"N": 2, "M": 3, "X": X, "y": y}
+    data_arrays = {"N": 2, "M": 3, **arrays}
+    expected = module.log_prob(data_lists, [0.5], False)  # type: ignore
+    assert np.allclose(module.log_prob(data_arrays, [0.5], False), expected)  # type: ignore
+
+
+@pytest.mark.asyncio
+async def test_array_data_integer_overflow(api_url: str) -> None:
+    """Test that integers which do not fit in a Stan int are rejected."""
+    model_name = await helpers.get_model_name(api_url, program_code)
+    module = httpstan.models.import_services_extension_module(model_name)
+    data = {"N": 2, "M": 3, "X": np.array(X), "y": np.array(y, dtype=np.int64) * 2 ** 40}
+    with pytest.raises(ValueError, match=r"out of range"):
+        module.log_prob(data, [0.5], False)  # type: ignore
@@ -0,0 +1,76 @@
+"""Test concurrent requests to log density endpoints."""
+import asyncio
+
+import aiohttp
+import numpy as np
+import pytest
+
+import helpers
+
+program_code = """
+data {
+  int N;
+}
+parameters {
+  vector[N] z;
+}
+model {
+  z ~ normal(0, 1);
+}
+"""
+
+
+@pytest.mark.asyncio
+async def test_concurrent_log_prob_grad(api_url: str) -> None:
+    """Test that concurrent requests, evaluated in different threads, are answered correctly."""
+    model_name = await helpers.get_model_name(api_url, program_code)
+    points = np.random.RandomState(1).normal(size=(16, 1000))
+
+    async def log_prob_grad(session: aiohttp.ClientSession, point: np.ndarray) -> list:
+        payload = {"data": {"N": len(point)}, "unconstrained_parameters": point.tolist()}
+        async with session.post(f"{api_url}/{model_name}/log_prob_grad", json=payload) as resp:
+            assert resp.status == 200
+            return (await resp.json())["log_prob_grad"]  # type: ignore
+
+    async def health(session: aiohttp.ClientSession) -> int:
+        async with session.get(f"{api_url}/health") as resp:
+            return resp.status
+
+    async with aiohttp.ClientSession() as session:
+        results = await asyncio.gather(health(session), *(log_prob_grad(session, point) for point in points))
+    assert results[0] == 200
+    for point, gradient in zip(points, results[1:]):
+        assert np.allclose(gradient, -point)
+
+
+@pytest.mark.asyncio
+async def test_concurrent_log_prob_batch_and_fits(api_url: str) -> None:
+    """Test that fits started while the thread pool evaluates the model finish."""
+    model_name = await helpers.get_model_name(api_url, program_code)
+    data = {"N": 100}
+    points = np.random.RandomState(1).normal(size=(256, 100))
+
+    async def log_prob_batch(session: aiohttp.ClientSession) -> None:
+        payload = {"data": data, "unconstrained_parameters": points.tolist(), "adjust_transform": False}
+        for _ in range(8):
+            async with session.post(f"{api_url}/{model_name}/log_prob_batch", json=payload) as resp:
+                assert resp.status == 200
+                log_probs = (await resp.json())["log_prob"]
+            # up to a constant, which `~` statements drop
+            expected = -0.5 * (points ** 2).sum(axis=1)
+            assert np.allclose(np.array(log_probs) - log_probs[0], expected - expected[0])
+
+    async def fit(random_seed: int) -> dict:
+        payload = {
+            "function": "stan::services::sample::hmc_nuts_diag_e_adapt",
+            "data": data,
+            "num_samples": 200,
+            "num_warmup": 200,
+            "random_seed": random_seed,
+        }
+        return await asyncio.wait_for(helpers.sample(api_url, program_code, payload), timeout=300)
+
+    async with aiohttp.ClientSession() as session:
+        results = await asyncio.gather(*(log_prob_batch(session) for _ in range(4)), *(fit(seed) for seed in range(4)))
+    for operation in results[4:]:
+        assert "name" in operation["result"], operation["result"]
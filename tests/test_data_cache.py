@@ -0,0 +1,75 @@
+"""Test the cache of parsed data in the services extension module."""
+import json
+
+import aiohttp
+import numpy as np
+import pytest
+
+import httpstan.models
+
+import helpers
+
+program_code = """
+    data {
+      int N;
+      real y[N];
+    }
+    parameters {
+      real mu;
+    }
+    model {
+      y ~ normal(mu, 1);
+    }
+"""
+
+data = {"N": 3, "y": [0.5, 1.0, 1.5]}
+
+
+@pytest.mark.asyncio
+async def test_data_cache_hits(api_url: str) -> None:
+    """Test that repeated requests with the same data use the cache."""
+    model_name = await helpers.get_model_name(api_url, program_code)
+    module = httpstan.models.import_services_extension_module(model_name)
+    module.clear_data_cache()  # type: ignore
+    before = module.data_cache_info()  # type: ignore
+
+    log_prob_url = f"{api_url}/{model_name}/log_prob"
+    payload = {"data": data, "unconstrained_parameters": [1.0], "adjust_transform": False}
+    log_probs = []
+    async with aiohttp.ClientSession() as session:
+        for _ in range(3):
+            # constructed models are reused, avoiding the data cache altogether
+            module.clear_model_pool()  # type: ignore
+            async with session.post(log_prob_url, json=payload) as resp:
+                assert resp.status == 200
+                log_probs.append((await resp.json())["log_prob"])
+    assert np.allclose(log_probs, log_probs[0])
+
+    info = module.data_cache_info()  # type: ignore
+    assert info["misses"] - before["misses"] == 1
+    assert info["hits"] - before["hits"] == 2
+    assert info["entries"] == 1
+    assert 0 < info["size"] <= info["capacity"]
+
+
+@pytest.mark.asyncio
+async def test_data_cache_capacity(api_url: str) -> None:
+    """Test that data is not cached beyond the capacity of the cache."""
+    model_name = await helpers.get_model_name(api_url, program_code)
+    module = httpstan.models.import_services_extension_module(model_name)
+    capacity = module.data_cache_info()["capacity"]  # type: ignore
+    module.clear_data_cache()  # type: ignore
+    module.set_data_cache_capacity(0)  # type: ignore
+    before = module.data_cache_info()  # type: ignore
+    try:
+        encoded = json.dumps(data).encode()
+        for _ in range(2):
+            # constructed models are reused, avoiding the data cache altogether
+            module.clear_model_pool()  # type: ignore
+            module.log_prob(encoded, [1.0], False)  # type: ignore
+        info = module.data_cache_info()  # type: ignore
+        assert info["misses"] - before["misses"] == 2
+        assert info["entries"] == 0
+        assert info["size"] == 0
+    finally:
+        module.set_data_cache_capacity(capacity)  # type: ignore
@@ -0,0 +1,118 @@
+"""Test data referring to NumPy files in the data directory."""
+import os
+import pathlib
+
+import aiohttp
+import numpy as np
+import pytest
+
+import httpstan.config
+
+import helpers
+
+program_code = """
+data {
+  int N;
+  int K;
+  matrix[N, K] X;
+  int y[N];
+}
+parameters {
+  real z;
+}
+transformed parameters {
+  real X_sum = sum(X);
+  real y_sum = sum(y);
+  real X_last = X[N, K];
+}
+model {
+  z ~ normal(0, 1);
+}
+"""
+
+X = np.arange(6.0).reshape(2, 3)
+y = np.array([4, 5], dtype=np.int64)
+
+
+async def _write_array(api_url: str, data: dict) -> aiohttp.ClientResponse:
+    model_name = await helpers.get_model_name(api_url, program_code)
+    payload = {"data": data, "unconstrained_parameters": [0.5]}
+    async with aiohttp.ClientSession() as session:
+        async with session.post(f"{api_url}/{model_name}/write_array", json=payload) as resp:
+            await resp.read()
+            return resp
+
+
+@pytest.mark.parametrize(
+    "files, data",
+    [
+        ({"X.npy": X, "y.npy": y}, {"X": "X.npy", "y": "y.npy"}),
+        ({"X.npy": np.asfortranarray(X), "y.npy": y.astype(np.int32)}, {"X": "X.npy", "y": "y.npy"}),
+        ({"X.npy": X.astype(np.float32), "sub/y.npy": y}, {"X": "X.npy", "y": "sub/y.npy"}),
+        ({"arrays.npz": {"X": X, "outcome": y}}, {"X": "arrays.npz", "y": "arrays.npz:outcome"}),
+    ],
+)
+@pytest.mark.asyncio
+async def test_data_files(files: dict, data: dict, api_url: str, tmp_path: pathlib.Path, monkeypatch) -> None:
+    """Test that referring to data files is equivalent to sending the values."""
+    for filename, value in files.items():
+        (tmp_path / filename).parent.mkdir(exist_ok=True)
+        if filename.endswith(".npz"):
+            np.savez(tmp_path / filename, **value)
+        else:
+            np.save(tmp_path / filename, value)
+    monkeypatch.setattr(httpstan.config, "HTTPSTAN_DATA_DIRECTORY", str(tmp_path))
+
+    resp = await _write_array(api_url, {"N": 2, "K": 3, **data})
+    assert resp.status == 200
+    assert np.allclose((await resp.json())["params_r_constrained"], [0.5, X.sum(), y.sum(), X[-1, -1]])
+
+
+@pytest.mark.asyncio
+async def test_data_files_changed(api_url: str, tmp_path: pathlib.Path, monkeypatch) -> None:
+    """Test that a data file is read again once it changes, rather than served from the cache."""
+    monkeypatch.setattr(httpstan.config, "HTTPSTAN_DATA_DIRECTORY", str(tmp_path))
+    data = {"N": 2, "K": 3, "X": "X.npy", "y": [4, 5]}
+    for scale in (1, 2):
+        np.save(tmp_path / "X.npy", scale * X)
+        # the new file has the same size, make sure its modification time differs
+        os.utime(tmp_path / "X.npy", ns=(scale * 10 ** 9, scale * 10 ** 9))
+        resp = await _write_array(api_url, data)
+        assert resp.status == 200
+        assert (await resp.json())["params_r_constrained"][1] == pytest.approx(scale * X.sum())
+
+
+@pytest.mark.parametrize(
+    "reference, message",
+    [
+        ("missing.npy", "not found"),
+        ("../outside.npy", "not found"),
+        ("/etc/passwd", "not found"),
+        ("arrays.npz:missing", "no member"),
+        ("compressed.npz", "compressed"),
+        ("strings.npy", "unsupported type"),
+    ],
+)
+@pytest.mark.asyncio
+async def test_data_files_invalid(
+    reference: str, message: str, api_url: str, tmp_path: pathlib.Path, monkeypatch
+) -> None:
+    directory = tmp_path / "data"
+    directory.mkdir()
+    np.save(tmp_path / "outside.npy", X)
+    np.savez(directory / "arrays.npz", X=X)
+    np.savez_compressed(directory / "compressed.npz", X=X)
+    np.save(directory / "strings.npy", np.array(["a", "b"]))
+    monkeypatch.setattr(httpstan.config, "HTTPSTAN_DATA_DIRECTORY", str(directory))
+
+    resp = await _write_array(api_url, {"N": 2, "K": 3, "X": reference, "y": [4, 5]})
+    assert resp.status == 400
+    assert message in (await resp.json())["message"]
+
+
+@pytest.mark.asyncio
+async def test_data_files_disabled(api_url: str, monkeypatch) -> None:
+    monkeypatch.setattr(httpstan.config, "HTTPSTAN_DATA_DIRECTORY", "")
+    resp = await _write_array(api_url, {"N": 2, "K": 3, "X": "X.npy", "y": [4, 5]})
+    assert resp.status == 400
+    assert "HTTPSTAN_DATA_DIRECTORY" in (await resp.json())["message"]
@@ -0,0 +1,205 @@
+"""Test summaries of fits."""
+import json
+import statistics
+
+import aiohttp
+import numpy as np
+import pytest
+
+import helpers
+import httpstan.cache
+import httpstan.summaries
+import httpstan.wire as wire
+
+program_code = "parameters {real y; vector[2] z;} model {y ~ normal(3, 2); z ~ normal(0, 1);}"
+
+
+@pytest.mark.parametrize(
+    "function", ["stan::services::sample::hmc_nuts_diag_e_adapt", "stan::services::sample::fixed_param"]
+)
+@pytest.mark.asyncio
+async def test_fit_summary(function: str, api_url: str) -> None:
+    """Test that the summary matches statistics computed from the draws, excluding warmup draws."""
+    num_samples = 500
+    payload = {"function": function, "num_samples": num_samples, "save_warmup": True, "random_seed": 1}
+    if function.endswith("fixed_param"):
+        del payload["save_warmup"]
+    operation = await helpers.sample(api_url, program_code, payload)
+    fit_name = operation["result"]["name"]
+    fit_bytes = await helpers.fit_bytes(api_url, fit_name)
+
+    async with aiohttp.ClientSession() as session:
+        async with session.get(f"{api_url}/{fit_name}/summary") as resp:
+            assert resp.status == 200
+            assert resp.content_type == "application/json"
+            summary = await resp.json()
+
+    assert summary["num_draws"] == num_samples
+    assert list(summary["parameters"])[:2] == ["lp__", "accept_stat__"]
+    for name in ("y", "z.1", "z.2"):
+        draws = helpers.extract(name, fit_bytes)[-num_samples:]
+        parameter = summary["parameters"][name]
+        assert parameter["mean"] == pytest.approx(statistics.mean(draws))
+        assert parameter["variance"] == pytest.approx(statistics.variance(draws))
+        assert (parameter["min"], parameter["max"]) == (min(draws), max(draws))
+        assert summary["probabilities"] == [0.05, 0.5, 0.95]
+        # with 500 draws, centroids of the t-digest hold few draws
+        tolerance = 0.05 * (max(draws) - min(draws))
+        assert parameter["quantiles"] == pytest.approx(np.quantile(draws, [0.05, 0.5, 0.95]), abs=tolerance)
+
+
+@pytest.mark.asyncio
+async def test_show_summary(api_url: str) -> None:
+    """Test that the summary of several fits is the summary of their combined draws."""
+    num_samples, draws = 400, []
+    fit_ids = []
+    for random_seed in (1, 2, 3):
+        payload = {
+            "function": "stan::services::sample::hmc_nuts_diag_e_adapt",
+            "num_samples": num_samples,
+            "random_seed": random_seed,
+        }
+        operation = await helpers.sample(api_url, program_code, payload)
+        fit_name = operation["result"]["name"]
+        draws.extend(helpers.extract("y", await helpers.fit_bytes(api_url, fit_name)))
+        fit_ids.append(fit_name.split("/")[-1])
+    model_name = fit_name.split("/fits/")[0]
+
+    async with aiohttp.ClientSession() as session:
+        summary_request = {"fits": fit_ids, "probabilities": [0.25, 0.75]}
+        async with session.post(f"{api_url}/{model_name}/summary", json=summary_request) as resp:
+            assert resp.status == 200
+            summary = await resp.json()
+        async with session.post(f"{api_url}/{model_name}/summary", json={"fits": ["no-such-fit"]}) as resp:
+            assert resp.status == 404
+
+    # fits made with different sampler arguments are not merged
+    payload = {
+        "function": "stan::services::sample::hmc_nuts_diag_e_adapt",
+        "num_samples": num_samples,
+        "random_seed": 1,
+        "num_warmup": 500,
+    }
+    operation = await helpers.sample(api_url, program_code, payload)
+    async with aiohttp.ClientSession() as session:
+        fits = [fit_ids[0], operation["result"]["name"].split("/")[-1]]
+        async with session.post(f"{api_url}/{model_name}/summary", json={"fits": fits}) as resp:
+            assert resp.status == 400
+            assert "sampler arguments" in (await resp.json())["message"]
+
+    assert summary["num_draws"] == 3 * num_samples
+    assert summary["probabilities"] == [0.25, 0.75]
+    parameter = summary["parameters"]["y"]
+    assert parameter["mean"] == pytest.approx(statistics.mean(draws))
+    assert parameter["variance"] == pytest.approx(statistics.variance(draws))
+    assert (parameter["min"], parameter["max"]) == (min(draws), max(draws))
+    tolerance = 0.05 * (max(draws) - min(draws))
+    assert parameter["quantiles"] == pytest.approx(np.quantile(draws, [0.25, 0.75]), abs=tolerance)
+    assert parameter["split_rhat"] == pytest.approx(1, abs=0.1)
+    assert parameter["ess"] > 0
+
+
+def _sketch(names: list, draws: np.ndarray, block_size: int = 1, data: str = "") -> bytes:
+    """Return the summary of draws, one column for each name, with a centroid for each draw."""
+    num_draws = len(draws)
+    num_blocks = num_draws // block_size
+    blocks = draws[: num_blocks * block_size].reshape(num_blocks, block_size, len(names))
+    header = {"num_draws": num_draws, "compression": 100, "block_size": block_size, "num_blocks": num_blocks}
+    fit = {"function": "fixed_param", "data": data, "arguments": {"num_thin": 1}}
+    header = json.dumps({**header, "names": names, "fit": fit}).encode()
+    arrays = {
+        "mean": draws.mean(axis=0) if num_draws else np.full(len(names), np.nan),
+        "variance": draws.var(axis=0, ddof=1) if num_draws > 1 else np.full(len(names), np.nan),
+        "min": draws.min(axis=0) if num_draws else np.full(len(names), np.nan),
+        "max": draws.max(axis=0) if num_draws else np.full(len(names), np.nan),
+        "num_centroids": np.full(len(names), float(num_draws)),
+        "centroid_means": draws.T.ravel(),
+        "centroid_weights": np.ones(draws.size),
+        "block_means": blocks.mean(axis=1).T.ravel(),
+        "block_m2": ((blocks - blocks.mean(axis=1, keepdims=True)) ** 2).sum(axis=1).T.ravel(),
+    }
+    return wire.encode(header, arrays)
+
+
+def test_merge_summaries() -> None:
+    """Test merging summaries without a server."""
+    rng = np.random.RandomState(1)
+    draws = [rng.normal(size=(n, 2)) for n in (5, 1, 0, 8)]
+    probabilities = [0, 0.05, 0.5, 0.95, 1]
+    summary = httpstan.summaries.merge([_sketch(["a", "b"], d) for d in draws], probabilities)
+
+    combined = np.concatenate(draws)
+    assert summary["num_draws"] == len(combined)
+    for j, name in enumerate(["a", "b"]):
+        parameter = summary["parameters"][name]
+        values = np.sort(combined[:, j])
+        assert parameter["mean"] == pytest.approx(values.mean())
+        assert parameter["variance"] == pytest.approx(values.var(ddof=1))
+        assert (parameter["min"], parameter["max"]) == (values[0], values[-1])
+        # centroids of one draw are centered half a draw from their neighbours
+        positions = np.concatenate([[0], np.arange(len(values)) + 0.5, [len(values)]])
+        points = np.concatenate([values[:1], values, values[-1:]])
+        expected = np.interp(np.array(probabilities) * len(values), positions, points)
+        assert parameter["quantiles"] == pytest.approx(expected.tolist())
+
+    with pytest.raises(ValueError):
+        httpstan.summaries.merge([_sketch(["a"], draws[0][:, :1]), _sketch(["b"], draws[0][:, :1])], probabilities)
+    with pytest.raises(ValueError, match="same data"):
+        sketches = [_sketch(["a", "b"], draws[0], data="1"), _sketch(["a", "b"], draws[3], data="2")]
+        httpstan.summaries.merge(sketches, probabilities)
+
+
+def test_merge_summaries_diagnostics() -> None:
+    """Test split-R-hat and ESS of merged summaries."""
+    rng = np.random.RandomState(1)
+    draws = rng.normal(size=(4, 1000, 1))
+    probabilities = [0.5]
+
+    # with blocks of one draw, split-R-hat is the usual split-R-hat
+    summary = httpstan.summaries.merge([_sketch(["a"], d) for d in draws], probabilities)
+    halves = draws[:, :, 0].reshape(8, 500)
+    within = halves.var(axis=1, ddof=1).mean()
+    var_plus = 499 / 500 * within + halves.mean(axis=1).var(ddof=1)
+    assert summary["parameters"]["a"]["split_rhat"] == pytest.approx(np.sqrt(var_plus / within))
+    assert summary["parameters"]["a"]["ess"] == pytest.approx(4000, rel=0.2)
+
+    # chains with blocks of different sizes are combined
+    summary = httpstan.summaries.merge([_sketch(["a"], d, 2 ** i) for i, d in enumerate(draws)], probabilities)
+    assert summary["parameters"]["a"]["split_rhat"] == pytest.approx(1, abs=0.02)
+    assert summary["parameters"]["a"]["ess"] == pytest.approx(4000, rel=0.5)
+
+    # correlated draws have fewer effective draws
+    correlated = np.cumsum(draws, axis=1) * 0.1 + draws
+    summary = httpstan.summaries.merge([_sketch(["a"], d, 16) for d in correlated], probabilities)
+    assert summary["parameters"]["a"]["ess"] < 400
+
+    # anticorrelated draws have more effective draws than draws, but a bounded number
+    alternating = draws * 0.1 + np.where(np.arange(1000) % 2, 1, -1)[np.newaxis, :, np.newaxis]
+    summary = httpstan.summaries.merge([_sketch(["a"], d) for d in alternating], probabilities)
+    assert 4000 < summary["parameters"]["a"]["ess"] <= 4000 * np.log10(4000)
+
+    # chains which do not mix
+    shifted = draws + np.arange(4)[:, np.newaxis, np.newaxis]
+    summary = httpstan.summaries.merge([_sketch(["a"], d, 16) for d in shifted], probabilities)
+    assert summary["parameters"]["a"]["split_rhat"] > 1.5
+
+    # too few blocks
+    summary = httpstan.summaries.merge([_sketch(["a"], d[:3]) for d in draws], probabilities)
+    assert np.isnan(summary["parameters"]["a"]["split_rhat"])
+    assert np.isnan(summary["parameters"]["a"]["ess"])
+
+
+@pytest.mark.asyncio
+async def test_fit_summary_deleted_with_fit(api_url: str) -> None:
+    """Test that the summary is deleted with its fit."""
+    payload = {"function": "stan::services::sample::hmc_nuts_diag_e_adapt", "num_samples": 10}
+    operation = await helpers.sample(api_url, program_code, payload)
+    fit_name = operation["result"]["name"]
+    assert httpstan.cache.fit_summary_path(fit_name).exists()
+
+    async with aiohttp.ClientSession() as session:
+        async with session.delete(f"{api_url}/{fit_name}") as resp:
+            assert resp.status == 200
+        async with session.get(f"{api_url}/{fit_name}/summary") as resp:
+            assert resp.status == 404
+    assert not httpstan.cache.fit_summary_path(fit_name).exists()
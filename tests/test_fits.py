@@ -3,10 +3,14 @@ import statistics
 from typing import Any, Dict, List, Optional, Union
 
 import aiohttp
+import lz4.frame
 import numpy as np
 import pytest
 
 import helpers
+import httpstan.cache
+import httpstan.fits
+import httpstan.models
 
 headers = {"content-type": "application/json"}
 program_code = "parameters {real y;} model {y ~ normal(0, 0.0001);}"
@@ -93,3 +97,53 @@ async def test_fits_vector_sizes(api_url: str) -> None:
     param_name = "x.1"
     with pytest.raises(KeyError, match="No draws found for parameter `x.1`."):
         await helpers.sample_then_extract(api_url, program_code_vector, payload, param_name)
+
+
+def test_decompress_concatenated_frames() -> None:
+    """Test that a fit may consist of several LZ4 frames."""
+    fit_bytes_lz4 = lz4.frame.compress(b"logger\n") + lz4.frame.compress(b"sample\n" * 1000)
+    assert httpstan.fits.decompress(fit_bytes_lz4) == b"logger\n" + b"sample\n" * 1000
+    with pytest.raises(ValueError, match="LZ4 frame"):
+        httpstan.fits.decompress(fit_bytes_lz4[:-4])
+
+
+@pytest.mark.asyncio
+async def test_fits_written_by_worker(api_url: str) -> None:
+    """Test that the stored fit holds one LZ4 frame for each channel and no temporary files remain."""
+    payload = {"function": "stan::services::sample::hmc_nuts_diag_e_adapt", "num_samples": 1000, "random_seed": 1}
+    operation = await helpers.sample(api_url, program_code, payload)
+    fit_name = operation["result"]["name"]
+    fit_bytes_lz4 = httpstan.cache.load_fit(fit_name)
+    path = httpstan.cache.fit_path(fit_name)
+    assert [p.name for p in path.parent.glob(f"{path.name}*")] == [path.name]
+    # the magic numbers of the frames of the logger, the sample writer and the diagnostic writer
+    assert fit_bytes_lz4.count(b"\x04\x22\x4d\x18") >= 3
+    fit_bytes = await helpers.fit_bytes(api_url, fit_name)
+    assert httpstan.fits.decompress(fit_bytes_lz4) == fit_bytes
+    assert len(helpers.extract("y", fit_bytes)) == 1000
+
+
+@pytest.mark.asyncio
+async def test_fit_name_canonical_data(api_url: str) -> None:
+    """Test that the fit name depends on the values in the data, not on how they are encoded."""
+    program_code_data = "data {int N; real x;} parameters {real y;} model {y ~ normal(x, 1);}"
+    model_name = await helpers.get_model_name(api_url, program_code_data)
+    function = "stan::services::sample::fixed_param"
+    payload = {"function": function, "random_seed": 1, "num_samples": 10, "data": {"N": 3, "x": 1.5}}
+    operation = await helpers.sample(api_url, program_code_data, payload)
+    fit_name = operation["result"]["name"]
+
+    # the same request with members in another order and other whitespace
+    body = f'{{"data":{{"x":1.5,  "N":3}},"num_samples":10,"random_seed":1,"function":"{function}"}}'
+    async with aiohttp.ClientSession() as session:
+        async with session.post(f"{api_url}/{model_name}/fits", data=body, headers=headers) as resp:
+            assert resp.status == 201
+            operation = await resp.json()
+    assert operation["done"]
+    assert operation["result"]["name"] == fit_name
+
+    # data given as a dict has the same digest as the same data JSON-encoded
+    module = httpstan.models.import_services_extension_module(model_name)
+    digest = module.canonical_data_digest(b'{"x": 1.5, "N": 3}')  # type: ignore
+    assert module.canonical_data_digest({"N": 3, "x": 1.5}) == digest  # type: ignore
+    assert module.canonical_data_digest({"N": 3, "x": 2.5}) != digest  # type: ignore
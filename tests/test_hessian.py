@@ -0,0 +1,88 @@
+"""Test hessian and hessian_vector_product endpoints."""
+import aiohttp
+import numpy as np
+import pytest
+
+import helpers
+
+program_code = """
+transformed data {
+  matrix[2, 2] A = [[2.0, 0.5], [0.5, 1.0]];
+}
+parameters {
+  vector[2] x;
+  real<lower=0> sigma;
+}
+model {
+  target += -0.5 * x' * A * x;
+  sigma ~ lognormal(0, 1);
+}
+"""
+
+A = np.array([[2.0, 0.5], [0.5, 1.0]])
+
+
+async def _post(api_url: str, endpoint: str, payload: dict) -> dict:
+    async with aiohttp.ClientSession() as session:
+        async with session.post(f"{api_url}/{endpoint}", json=payload) as resp:
+            assert resp.status == 200
+            return await resp.json()  # type: ignore
+
+
+@pytest.mark.asyncio
+async def test_hessian_analytically(api_url: str) -> None:
+    """Test the Hessian of a Gaussian log density."""
+    model_name = await helpers.get_model_name(api_url, program_code)
+    x = np.array([0.3, -1.2, 0.1])
+    payload = {"unconstrained_parameters": x.tolist(), "adjust_transform": False}
+    response = await _post(api_url, f"{model_name}/hessian", payload)
+    hessian = np.array(response["hessian"])
+    assert hessian.shape == (3, 3)
+    assert np.allclose(hessian[:2, :2], -A)
+    assert np.allclose(hessian[:2, 2], 0)
+    assert np.allclose(response["log_prob_grad"][:2], -A @ x[:2])
+
+
+@pytest.mark.parametrize("adjust_transform", [True, False])
+@pytest.mark.asyncio
+async def test_hessian_consistency(adjust_transform: bool, api_url: str) -> None:
+    """Test the Hessian and Hessian-vector product against log_prob_grad."""
+    model_name = await helpers.get_model_name(api_url, program_code)
+    x = np.array([0.3, -1.2, 0.7])
+    v = np.array([1.0, -2.0, 0.5])
+    payload = {"unconstrained_parameters": x.tolist(), "adjust_transform": adjust_transform}
+    response = await _post(api_url, f"{model_name}/hessian", payload)
+    hessian = np.array(response["hessian"])
+    assert np.allclose(hessian, hessian.T)
+
+    log_prob = await _post(api_url, f"{model_name}/log_prob", payload)
+    assert np.allclose(response["log_prob"], log_prob["log_prob"])
+    gradient = await _post(api_url, f"{model_name}/log_prob_grad", payload)
+    assert np.allclose(response["log_prob_grad"], gradient["log_prob_grad"])
+
+    # central differences of the gradient
+    epsilon = 1e-6
+    columns = []
+    for i in range(len(x)):
+        step = np.eye(len(x))[i] * epsilon
+        gradients = []
+        for point in (x + step, x - step):
+            payload = {"unconstrained_parameters": point.tolist(), "adjust_transform": adjust_transform}
+            gradients.append(np.array((await _post(api_url, f"{model_name}/log_prob_grad", payload))["log_prob_grad"]))
+        columns.append((gradients[0] - gradients[1]) / (2 * epsilon))
+    assert np.allclose(hessian, np.stack(columns, axis=1), atol=1e-5)
+
+    payload = {"unconstrained_parameters": x.tolist(), "vector": v.tolist(), "adjust_transform": adjust_transform}
+    response = await _post(api_url, f"{model_name}/hessian_vector_product", payload)
+    assert np.allclose(response["hessian_vector_product"], hessian @ v)
+    assert np.allclose(response["log_prob"], log_prob["log_prob"])
+
+
+@pytest.mark.asyncio
+async def test_hessian_vector_product_wrong_size(api_url: str) -> None:
+    model_name = await helpers.get_model_name(api_url, program_code)
+    payload = {"unconstrained_parameters": [0.0, 0.0, 0.0], "vector": [1.0]}
+    async with aiohttp.ClientSession() as session:
+        async with session.post(f"{api_url}/{model_name}/hessian_vector_product", json=payload) as resp:
+            assert resp.status == 400
+            assert "vector" in (await resp.json())["message"]
@@ -0,0 +1,68 @@
+"""Test selecting the columns written in draws."""
+import aiohttp
+import pytest
+
+import helpers
+
+program_code = """
+    parameters {
+      real y;
+      vector[3] z;
+    }
+    model {
+      y ~ normal(0, 1);
+      z ~ normal(0, 1);
+    }
+    generated quantities {
+      vector[3] w = 2 * z;
+    }
+"""
+
+
+async def _sample_fields(api_url: str, payload: dict) -> tuple:
+    """Return the names of the columns and the fit."""
+    operation = await helpers.sample(api_url, program_code, payload)
+    fit_name = operation["result"]["name"]
+    fit_bytes = await helpers.fit_bytes(api_url, fit_name)
+    draws = [message["values"] for message in helpers.decode_messages(fit_bytes) if message["topic"] == "sample"]
+    draws = [draw for draw in draws if isinstance(draw, dict)]
+    assert len({tuple(draw) for draw in draws}) == 1
+    return list(draws[0]), fit_name, fit_bytes
+
+
+@pytest.mark.parametrize("message_version", [1, 3])
+@pytest.mark.asyncio
+async def test_include_exclude(message_version: int, api_url: str) -> None:
+    """Test that draws only have the selected columns."""
+    payload = {
+        "function": "stan::services::sample::hmc_nuts_diag_e_adapt",
+        "num_samples": 50,
+        "random_seed": 1,
+        "message_version": message_version,
+    }
+    fields, _, fit_bytes = await _sample_fields(api_url, payload)
+    assert fields[0] == "lp__"
+    assert fields[-6:] == ["z.1", "z.2", "z.3", "w.1", "w.2", "w.3"]
+    sampler_fields = fields[:-7]
+
+    selected = {**payload, "include": ["z", "w.?"], "exclude": ["z.2", "w.3", "divergent__"]}
+    fields_selected, fit_name, fit_bytes_selected = await _sample_fields(api_url, selected)
+    expected = [field for field in sampler_fields if field != "divergent__"] + ["z.1", "z.3", "w.1", "w.2"]
+    assert fields_selected == expected
+    assert len(fit_bytes_selected) < len(fit_bytes)
+    assert helpers.extract("w.2", fit_bytes_selected) == helpers.extract("w.2", fit_bytes)
+
+    async with aiohttp.ClientSession() as session:
+        async with session.get(f"{api_url}/{fit_name}/summary") as resp:
+            assert resp.status == 200
+            summary = await resp.json()
+    assert list(summary["parameters"]) == expected
+
+
+@pytest.mark.asyncio
+async def test_exclude_all(api_url: str) -> None:
+    """Test that excluding every column is an error."""
+    payload = {"function": "stan::services::sample::hmc_nuts_diag_e_adapt", "num_samples": 10, "exclude": ["*"]}
+    operation = await helpers.sample(api_url, program_code, payload)
+    assert operation["result"]["code"] == 400
+    assert "No columns match" in operation["result"]["message"]
@@ -0,0 +1,82 @@
+"""Test data parsed by the services extension module."""
+import aiohttp
+import numpy as np
+import pytest
+
+import helpers
+
+program_code = """
+    data {
+      matrix[2, 3] X;
+      int y[3, 2];
+    }
+    parameters {
+      real mu;
+    }
+    model {
+      mu ~ normal(X[1, 2] + y[3, 1], 1);
+    }
+"""
+
+data = {"X": [[1.0, 2.0, 3.0], [4.0, 5.0, 6.0]], "y": [[1, 2], [3, 4], [5, 6]]}
+
+
+@pytest.mark.asyncio
+async def test_json_data_order(api_url: str) -> None:
+    """Test that nested arrays are read in row-major order."""
+    model_name = await helpers.get_model_name(api_url, program_code)
+    log_prob_url = f"{api_url}/{model_name}/log_prob"
+    payload = {"data": data, "unconstrained_parameters": [4.0], "adjust_transform": False}
+    async with aiohttp.ClientSession() as session:
+        async with session.post(log_prob_url, json=payload) as resp:
+            assert resp.status == 200
+            response_payload = await resp.json()
+    # mu ~ normal(2 + 5, 1)
+    assert np.allclose(response_payload["log_prob"], -0.5 * (4.0 - 7.0) ** 2)
+
+
+@pytest.mark.parametrize(
+    "invalid_data",
+    [
+        {"X": [[1.0, 2.0, 3.0], [4.0, 5.0]], "y": data["y"]},
+        {"X": [[1.0, 2.0, 3.0], 4.0], "y": data["y"]},
+    ],
+)
+@pytest.mark.asyncio
+async def test_json_data_ragged(invalid_data: dict, api_url: str) -> None:
+    """Test that ragged nested arrays are rejected."""
+    model_name = await helpers.get_model_name(api_url, program_code)
+    log_prob_url = f"{api_url}/{model_name}/log_prob"
+    payload = {"data": invalid_data, "unconstrained_parameters": [4.0]}
+    async with aiohttp.ClientSession() as session:
+        async with session.post(log_prob_url, json=payload) as resp:
+            assert resp.status == 400
+            response_payload = await resp.json()
+    assert "rectangular" in response_payload["message"]
+
+
+@pytest.mark.asyncio
+async def test_json_data_invalid_value(api_url: str) -> None:
+    """Test that data values other than numbers are rejected as before."""
+    model_name = await helpers.get_model_name(api_url, program_code)
+    log_prob_url = f"{api_url}/{model_name}/log_prob"
+    payload = {"data": {"X": "hello", "y": data["y"]}, "unconstrained_parameters": [4.0]}
+    async with aiohttp.ClientSession() as session:
+        async with session.post(log_prob_url, json=payload) as resp:
+            assert resp.status == 422
+            response_payload = await resp.json()
+    assert "data" in response_payload["json"]
+
+
+@pytest.mark.asyncio
+async def test_json_data_duplicate_key(api_url: str) -> None:
+    """Test that a variable given more than once is rejected."""
+    model_name = await helpers.get_model_name(api_url, program_code)
+    log_prob_url = f"{api_url}/{model_name}/log_prob"
+    body = '{"data": {"X": [[1, 2, 3], [4, 5, 6]], "y": [[1, 2], [3, 4], [5, 6]], "X": [[0, 0, 0], [0, 0, 0]]}, '
+    body += '"unconstrained_parameters": [4.0]}'
+    async with aiohttp.ClientSession() as session:
+        async with session.post(log_prob_url, data=body, headers={"content-type": "application/json"}) as resp:
+            assert resp.status == 400
+            response_payload = await resp.json()
+    assert "more than one value for `X`" in response_payload["message"]
@@ -0,0 +1,66 @@
+"""Test batched log_prob endpoint."""
+import aiohttp
+import numpy as np
+import pytest
+
+import helpers
+
+program_code = """
+parameters {
+  real y;
+  real<lower=0> sigma;
+}
+model {
+  y ~ normal(0, sigma);
+  sigma ~ lognormal(0, 1);
+}
+"""
+
+points = np.random.RandomState(1).uniform(-2, 2, size=(257, 2))
+
+
+@pytest.mark.parametrize("adjust_transform", [True, False])
+@pytest.mark.asyncio
+async def test_log_prob_batch(adjust_transform: bool, api_url: str) -> None:
+    """Test that batched log probabilities match the log_prob endpoint."""
+    model_name = await helpers.get_model_name(api_url, program_code)
+    payload = {"unconstrained_parameters": points.tolist(), "adjust_transform": adjust_transform}
+    async with aiohttp.ClientSession() as session:
+        async with session.post(f"{api_url}/{model_name}/log_prob_batch", json=payload) as resp:
+            assert resp.status == 200
+            log_probs = (await resp.json())["log_prob"]
+        assert len(log_probs) == len(points)
+        for point, lp in zip(points[:5], log_probs[:5]):
+            payload = {"unconstrained_parameters": point.tolist(), "adjust_transform": adjust_transform}
+            async with session.post(f"{api_url}/{model_name}/log_prob", json=payload) as resp:
+                assert resp.status == 200
+                assert np.allclose((await resp.json())["log_prob"], lp)
+
+
+@pytest.mark.parametrize(
+    "unconstrained_parameters",
+    [
+        [[0.5, 0.1, 0.2]],
+        [[0.5, 0.1], [0.2]],
+    ],
+)
+@pytest.mark.asyncio
+async def test_log_prob_batch_wrong_shape(unconstrained_parameters: list, api_url: str) -> None:
+    """Test that parameter matrices with the wrong shape are rejected."""
+    model_name = await helpers.get_model_name(api_url, program_code)
+    payload = {"unconstrained_parameters": unconstrained_parameters}
+    async with aiohttp.ClientSession() as session:
+        async with session.post(f"{api_url}/{model_name}/log_prob_batch", json=payload) as resp:
+            assert resp.status == 400
+            assert "log_prob_batch" in (await resp.json())["message"]
+
+
+@pytest.mark.asyncio
+async def test_log_prob_batch_empty(api_url: str) -> None:
+    """Test that an empty batch is rejected."""
+    model_name = await helpers.get_model_name(api_url, program_code)
+    payload = {"unconstrained_parameters": []}
+    async with aiohttp.ClientSession() as session:
+        async with session.post(f"{api_url}/{model_name}/log_prob_batch", json=payload) as resp:
+            assert resp.status == 422
+            assert "unconstrained_parameters" in (await resp.json())["json"]
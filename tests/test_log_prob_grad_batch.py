@@ -0,0 +1,68 @@
+"""Test batched log_prob_grad endpoint."""
+import aiohttp
+import numpy as np
+import pytest
+
+import httpstan.models
+
+import helpers
+
+program_code = """
+parameters {
+  vector[3] beta;
+  real<lower=0> sigma;
+}
+model {
+  beta ~ normal(0, sigma);
+  sigma ~ exponential(1);
+}
+"""
+
+points = np.random.RandomState(1).uniform(-2, 2, size=(129, 4))
+
+
+@pytest.mark.parametrize("adjust_transform", [True, False])
+@pytest.mark.asyncio
+async def test_log_prob_grad_batch(adjust_transform: bool, api_url: str) -> None:
+    """Test that batched gradients match the log_prob and log_prob_grad endpoints."""
+    model_name = await helpers.get_model_name(api_url, program_code)
+    payload = {"unconstrained_parameters": points.tolist(), "adjust_transform": adjust_transform}
+    async with aiohttp.ClientSession() as session:
+        async with session.post(f"{api_url}/{model_name}/log_prob_grad_batch", json=payload) as resp:
+            assert resp.status == 200
+            response_payload = await resp.json()
+        log_probs, gradients = response_payload["log_prob"], response_payload["log_prob_grad"]
+        assert np.shape(gradients) == points.shape
+        for point, lp, gradient in zip(points[:5], log_probs[:5], gradients[:5]):
+            payload = {"unconstrained_parameters": point.tolist(), "adjust_transform": adjust_transform}
+            async with session.post(f"{api_url}/{model_name}/log_prob", json=payload) as resp:
+                assert resp.status == 200
+                assert np.allclose((await resp.json())["log_prob"], lp)
+            async with session.post(f"{api_url}/{model_name}/log_prob_grad", json=payload) as resp:
+                assert resp.status == 200
+                assert np.allclose((await resp.json())["log_prob_grad"], gradient)
+
+
+@pytest.mark.asyncio
+async def test_log_prob_grad_batch_contiguous(api_url: str) -> None:
+    """Test that the extension module returns gradients in one C-contiguous array."""
+    model_name = await helpers.get_model_name(api_url, program_code)
+    module = httpstan.models.import_services_extension_module(model_name)
+    # Fortran-ordered input is accepted as well
+    log_probs, gradients = module.log_prob_grad_batch({}, np.asfortranarray(points), True)  # type: ignore
+    assert log_probs.shape == (len(points),)
+    assert gradients.shape == points.shape
+    assert gradients.flags["C_CONTIGUOUS"]
+    for point, gradient in zip(points[:5], gradients[:5]):
+        assert np.allclose(module.log_prob_grad({}, point.tolist(), True), gradient)  # type: ignore
+
+
+@pytest.mark.asyncio
+async def test_log_prob_grad_batch_wrong_shape(api_url: str) -> None:
+    """Test that a parameter matrix with the wrong number of columns is rejected."""
+    model_name = await helpers.get_model_name(api_url, program_code)
+    payload = {"unconstrained_parameters": [[0.5, 0.1]]}
+    async with aiohttp.ClientSession() as session:
+        async with session.post(f"{api_url}/{model_name}/log_prob_grad_batch", json=payload) as resp:
+            assert resp.status == 400
+            assert "number of parameters" in (await resp.json())["message"]
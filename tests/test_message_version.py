@@ -0,0 +1,100 @@
+"""Test versions 2 and 3 of the format of messages in a fit."""
+import json
+import re
+import struct
+
+import pytest
+
+import helpers
+
+program_code = """
+    parameters {
+      vector[50] z;
+    }
+    model {
+      z ~ normal(0, 1);
+    }
+"""
+
+
+async def _fit_bytes(api_url: str, payload: dict) -> bytes:
+    operation = await helpers.sample(api_url, program_code, payload)
+    return await helpers.fit_bytes(api_url, operation["result"]["name"])
+
+
+@pytest.mark.parametrize("message_version", [2, 3])
+@pytest.mark.parametrize(
+    "function", ["stan::services::sample::hmc_nuts_diag_e_adapt", "stan::services::sample::fixed_param"]
+)
+@pytest.mark.asyncio
+async def test_message_version(message_version: int, function: str, api_url: str) -> None:
+    """Test that draws in later versions are the draws in version 1, without the field names."""
+    payload = {"function": function, "num_samples": 100, "random_seed": 1}
+    fit_bytes_v1 = await _fit_bytes(api_url, payload)
+    fit_bytes_v2 = await _fit_bytes(api_url, {**payload, "message_version": message_version})
+    assert len(fit_bytes_v2) < len(fit_bytes_v1) / 2
+
+    (header,) = re.findall(rb'{"version":\d,"topic":"sample","fields":\[[^\]]*\]}', fit_bytes_v2)
+    sample_fields = json.loads(header)["fields"]
+    assert sample_fields[0] == "lp__"
+    assert sample_fields[-1] == "z.50"
+
+    messages_v1 = [msg for msg in helpers.decode_messages(fit_bytes_v1) if msg["topic"] == "sample"]
+    messages_v2 = [msg for msg in helpers.decode_messages(fit_bytes_v2) if msg["topic"] == "sample"]
+    assert len(messages_v1) == len(messages_v2)
+    for msg_v1, msg_v2 in zip(messages_v1, messages_v2):
+        assert msg_v1["values"] == msg_v2["values"]
+
+    assert helpers.extract("z.1", fit_bytes_v1) == helpers.extract("z.1", fit_bytes_v2)
+
+
+@pytest.mark.asyncio
+async def test_message_version_binary_frames(api_url: str) -> None:
+    """Test the headers of binary frames, and that frames hold consecutive draws."""
+    payload = {
+        "function": "stan::services::sample::fixed_param",
+        "num_samples": 1000,
+        "chain": 3,
+        "message_version": 3,
+    }
+    fit_bytes = await _fit_bytes(api_url, payload)
+    position, frames = fit_bytes.index(b"\xff"), []
+    while position < len(fit_bytes) and fit_bytes[position] == 0xFF:
+        channel, value_size, chain, first, num_draws, num_values, length = struct.unpack_from(
+            "<xBBxIIIII", fit_bytes, position
+        )
+        assert (channel, value_size, chain, length) == (1, 8, 3, num_draws * num_values * 8)
+        # a frame is written once its values reach 64 KiB
+        assert length <= 64 * 1024
+        frames.append((first, num_draws))
+        position += 24 + length
+    assert 1 < len(frames) < 1000
+    assert [first for first, _ in frames] == [sum(n for _, n in frames[:i]) for i in range(len(frames))]
+    assert sum(n for _, n in frames) == 1000
+
+
+@pytest.mark.parametrize("message_version", [1, 3])
+@pytest.mark.asyncio
+async def test_significant_digits(message_version: int, api_url: str) -> None:
+    """Test that draws with fewer significant digits are smaller and close to the draws at full precision."""
+    payload = {
+        "function": "stan::services::sample::hmc_nuts_diag_e_adapt",
+        "num_samples": 100,
+        "random_seed": 1,
+        "message_version": message_version,
+    }
+    fit_bytes = await _fit_bytes(api_url, payload)
+    fit_bytes_reduced = await _fit_bytes(api_url, {**payload, "significant_digits": 4})
+    assert len(fit_bytes_reduced) < len(fit_bytes) * 0.75
+
+    if message_version == 3:
+        (value_size,) = struct.unpack_from("<xxB", fit_bytes_reduced, fit_bytes_reduced.index(b"\xff"))
+        assert value_size == 4
+    else:
+        for value in re.findall(rb'"z\.1":([^,}]*)', fit_bytes_reduced):
+            # digits of the significand, without leading zeros
+            assert len(re.sub(rb"e.*|[-.]", b"", value).lstrip(b"0")) <= 4
+
+    draws = helpers.extract("z.1", fit_bytes)
+    draws_reduced = helpers.extract("z.1", fit_bytes_reduced)
+    assert draws_reduced == pytest.approx(draws, rel=1e-3)
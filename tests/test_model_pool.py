@@ -0,0 +1,85 @@
+"""Test the pool of constructed models in the services extension module."""
+import aiohttp
+import numpy as np
+import pytest
+
+import httpstan.models
+
+import helpers
+
+program_code = """
+    data {
+      int N;
+      vector[N] y;
+    }
+    transformed data {
+      real y_sum = sum(y);
+    }
+    parameters {
+      real mu;
+    }
+    model {
+      mu ~ normal(y_sum, 1);
+    }
+"""
+
+
+@pytest.mark.asyncio
+async def test_model_pool_reuse(api_url: str) -> None:
+    """Test that a model is constructed once for calls with the same data."""
+    model_name = await helpers.get_model_name(api_url, program_code)
+    module = httpstan.models.import_services_extension_module(model_name)
+    module.clear_model_pool()  # type: ignore
+    before = module.model_pool_info()  # type: ignore
+
+    data = {"N": 3, "y": [1.0, 2.0, 3.0]}
+    payload = {"data": data, "unconstrained_parameters": [6.5], "adjust_transform": False}
+    async with aiohttp.ClientSession() as session:
+        async with session.post(f"{api_url}/{model_name}/log_prob", json=payload) as resp:
+            assert resp.status == 200
+            assert np.allclose((await resp.json())["log_prob"], -0.5 * 0.5 ** 2)
+        async with session.post(f"{api_url}/{model_name}/log_prob_grad", json=payload) as resp:
+            assert resp.status == 200
+            assert np.allclose((await resp.json())["log_prob_grad"], [-0.5])
+        payload = {"data": data, "unconstrained_parameters": [6.5]}
+        async with session.post(f"{api_url}/{model_name}/write_array", json=payload) as resp:
+            assert resp.status == 200
+
+    info = module.model_pool_info()  # type: ignore
+    assert info["misses"] - before["misses"] == 1
+    assert info["hits"] - before["hits"] == 2
+    assert info["entries"] == 1
+
+
+@pytest.mark.asyncio
+async def test_model_pool_different_data(api_url: str) -> None:
+    """Test that models constructed with different data are not confused."""
+    model_name = await helpers.get_model_name(api_url, program_code)
+    module = httpstan.models.import_services_extension_module(model_name)
+    module.clear_model_pool()  # type: ignore
+
+    log_probs = []
+    async with aiohttp.ClientSession() as session:
+        for y in ([1.0, 2.0, 3.0], [4.0, 5.0, 6.0], [1.0, 2.0, 3.0]):
+            payload = {"data": {"N": 3, "y": y}, "unconstrained_parameters": [6.0], "adjust_transform": False}
+            async with session.post(f"{api_url}/{model_name}/log_prob", json=payload) as resp:
+                assert resp.status == 200
+                log_probs.append((await resp.json())["log_prob"])
+    assert np.allclose(log_probs, [0.0, -0.5 * 9.0 ** 2, 0.0])
+    assert module.model_pool_info()["entries"] == 2  # type: ignore
+
+
+@pytest.mark.asyncio
+async def test_model_pool_cleared_on_delete(api_url: str) -> None:
+    """Test that deleting a model releases its pooled instances."""
+    model_name = await helpers.get_model_name(api_url, program_code)
+    module = httpstan.models.import_services_extension_module(model_name)
+
+    payload = {"data": {"N": 1, "y": [1.0]}, "unconstrained_parameters": [1.0], "adjust_transform": False}
+    async with aiohttp.ClientSession() as session:
+        async with session.post(f"{api_url}/{model_name}/log_prob", json=payload) as resp:
+            assert resp.status == 200
+        assert module.model_pool_info()["entries"] > 0  # type: ignore
+        async with session.delete(f"{api_url}/{model_name}") as resp:
+            assert resp.status == 200
+    assert module.model_pool_info()["entries"] == 0  # type: ignore
@@ -15,9 +15,14 @@ def test_data_schema() -> None:
     assert result
 
 
+def test_data_schema_file_reference() -> None:
+    result = schemas.Data().load({"y": [3, 2, 4], "X": "X.npy"})
+    assert result
+
+
 def test_data_schema_invalid() -> None:
     with pytest.raises(ValidationError):
-        schemas.Data().load({"y": [3, 2, 4], "p": "hello"})
+        schemas.Data().load({"y": [3, 2, 4], "p": ["hello"]})
 
 
 def test_writer_message_schema_mapping() -> None:
@@ -44,6 +49,27 @@ def test_writer_message_schema_list() -> None:
     assert result
 
 
+def test_writer_message_schema_fields() -> None:
+    payload = {
+        "version": 2,
+        "topic": "sample",
+        "fields": ["lp__", "y"],
+    }
+    result = schemas.WriterMessage().load(payload)
+    assert result["field_names"] == ["lp__", "y"]
+
+
+def test_writer_message_schema_invalid_fields_and_values() -> None:
+    payload = {
+        "version": 2,
+        "topic": "sample",
+        "fields": ["lp__", "y"],
+        "values": [-0.259381, 0.720251],
+    }
+    with pytest.raises(ValidationError):
+        schemas.WriterMessage().load(payload)
+
+
 def test_writer_message_schema_invalid_missing_field() -> None:
     payload = {
         "version": 1,
@@ -0,0 +1,79 @@
+"""Test ending sampling once a target effective sample size is reached."""
+import aiohttp
+import pytest
+
+import helpers
+
+program_code = "parameters {real y; real z;} model {y ~ normal(0, 1); z ~ normal(0, 1);}"
+
+
+async def _summary(api_url: str, fit_name: str) -> dict:
+    async with aiohttp.ClientSession() as session:
+        async with session.get(f"{api_url}/{fit_name}/summary") as resp:
+            assert resp.status == 200
+            return await resp.json()
+
+
+@pytest.mark.asyncio
+async def test_target_ess(api_url: str) -> None:
+    """Test that sampling ends early, and that the fit is marked truncated."""
+    num_samples, target_ess = 10000, 200
+    payload = {
+        "function": "stan::services::sample::hmc_nuts_diag_e_adapt",
+        "num_samples": num_samples,
+        "random_seed": 1,
+        "target_ess": target_ess,
+        "target_ess_parameters": ["y"],
+    }
+    operation = await helpers.sample(api_url, program_code, payload)
+    fit_name = operation["result"]["name"]
+    fit_bytes = await helpers.fit_bytes(api_url, fit_name)
+    summary = await _summary(api_url, fit_name)
+
+    assert summary["truncated"]
+    # the effective sample size of anticorrelated draws can exceed the number of draws
+    assert 64 <= summary["num_draws"] < num_samples
+    assert summary["parameters"]["y"]["ess"] >= target_ess
+    assert len(helpers.extract("y", fit_bytes)) == summary["num_draws"]
+    messages = helpers.decode_messages(fit_bytes)
+    assert any("Sampling stopped" in str(msg["values"]) for msg in messages if msg["topic"] == "logger")
+
+    # without a target, all draws are made
+    del payload["target_ess"]
+    operation = await helpers.sample(api_url, program_code, {**payload, "num_samples": 1000})
+    summary = await _summary(api_url, operation["result"]["name"])
+    assert not summary["truncated"]
+    assert summary["num_draws"] == 1000
+
+
+@pytest.mark.asyncio
+async def test_target_ess_constant_column(api_url: str) -> None:
+    """Test that a constant generated quantity, watched by default, does not keep sampling going."""
+    program_code_constant = "parameters {real y;} model {y ~ normal(0, 1);} generated quantities {real c = 1;}"
+    num_samples = 10000
+    payload = {
+        "function": "stan::services::sample::hmc_nuts_diag_e_adapt",
+        "num_samples": num_samples,
+        "random_seed": 1,
+        "target_ess": 200,
+    }
+    operation = await helpers.sample(api_url, program_code_constant, payload)
+    summary = await _summary(api_url, operation["result"]["name"])
+    assert summary["truncated"]
+    assert summary["num_draws"] < num_samples
+    assert summary["parameters"]["y"]["ess"] >= 200
+
+
+@pytest.mark.asyncio
+async def test_target_ess_no_parameters(api_url: str) -> None:
+    """Test that watching no parameters is an error, raised before warmup."""
+    payload = {
+        "function": "stan::services::sample::hmc_nuts_diag_e_adapt",
+        "num_warmup": 1_000_000,
+        "num_samples": 100,
+        "target_ess": 100,
+        "target_ess_parameters": ["no_such_parameter"],
+    }
+    operation = await helpers.sample(api_url, program_code, payload)
+    assert operation["result"]["code"] == 400
+    assert "No columns match" in operation["result"]["message"]
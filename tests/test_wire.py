@@ -0,0 +1,135 @@
+"""Test the binary wire format for log density endpoints."""
+import json
+
+import aiohttp
+import numpy as np
+import pytest
+
+import httpstan.wire as wire
+
+import helpers
+
+program_code = """
+data {
+  int N;
+}
+parameters {
+  vector[N] z;
+}
+transformed parameters {
+  vector[N] z_squared = z .* z;
+}
+model {
+  z ~ normal(0, 1);
+}
+"""
+
+data = {"N": 3}
+z = np.array([0.5, -1.5, 2.0])
+
+
+def test_wire_round_trip() -> None:
+    """Test that arrays survive encoding and decoding."""
+    arrays = {"a": np.arange(6.0).reshape(2, 3), "b": np.float64(3.5), "c": np.array([1.0]), "d": np.zeros((0, 4))}
+    header = json.dumps({"x": 1}).encode()
+    message = wire.encode(header, arrays)
+    decoded_header, decoded = wire.decode(message)
+    assert decoded_header == header
+    assert list(decoded) == list(arrays)
+    for name, array in arrays.items():
+        assert decoded[name].shape == np.shape(array)
+        assert np.array_equal(decoded[name], array)
+        # values are aligned views of the message
+        assert decoded[name].flags["ALIGNED"]
+        assert not decoded[name].flags["WRITEABLE"]
+
+
+@pytest.mark.parametrize(
+    "message",
+    [b"", b"XXXX", wire.MAGIC + b"\x10\x00\x00\x00{}", wire.encode(b"{}", {"a": np.ones(4)})[:-8]],
+)
+def test_wire_invalid(message: bytes) -> None:
+    with pytest.raises(ValueError):
+        wire.decode(message)
+
+
+async def _post(url: str, header: dict, arrays: dict) -> tuple:
+    headers = {"Content-Type": wire.MEDIA_TYPE, "Accept": wire.MEDIA_TYPE}
+    async with aiohttp.ClientSession() as session:
+        async with session.post(url, data=wire.encode(json.dumps(header).encode(), arrays), headers=headers) as resp:
+            return resp.status, resp.content_type, await resp.read()
+
+
+@pytest.mark.asyncio
+async def test_wire_log_prob_grad(api_url: str) -> None:
+    """Test a binary request and response against JSON."""
+    model_name = await helpers.get_model_name(api_url, program_code)
+    url = f"{api_url}/{model_name}/log_prob_grad"
+    header = {"data": data, "adjust_transform": False}
+    status, content_type, body = await _post(url, header, {"unconstrained_parameters": z})
+    assert status == 200
+    assert content_type == wire.MEDIA_TYPE
+    _, arrays = wire.decode(body)
+    assert np.allclose(arrays["log_prob_grad"], -z)
+
+    payload = {"data": data, "unconstrained_parameters": z.tolist(), "adjust_transform": False}
+    async with aiohttp.ClientSession() as session:
+        async with session.post(url, json=payload) as resp:
+            assert resp.status == 200
+            assert resp.content_type == "application/json"
+            assert np.allclose((await resp.json())["log_prob_grad"], arrays["log_prob_grad"])
+
+
+@pytest.mark.asyncio
+async def test_wire_write_array(api_url: str) -> None:
+    model_name = await helpers.get_model_name(api_url, program_code)
+    url = f"{api_url}/{model_name}/write_array"
+    status, _, body = await _post(url, {"data": data}, {"unconstrained_parameters": z})
+    assert status == 200
+    _, arrays = wire.decode(body)
+    assert np.allclose(arrays["params_r_constrained"], np.concatenate([z, z ** 2]))
+
+
+@pytest.mark.asyncio
+async def test_wire_log_prob_batch(api_url: str) -> None:
+    model_name = await helpers.get_model_name(api_url, program_code)
+    url = f"{api_url}/{model_name}/log_prob_batch"
+    points = np.stack([z, 2 * z])
+    status, _, body = await _post(url, {"data": data, "adjust_transform": False}, {"unconstrained_parameters": points})
+    assert status == 200
+    _, arrays = wire.decode(body)
+    assert np.allclose(arrays["log_prob"], -0.5 * (points ** 2).sum(axis=1))
+
+
+@pytest.mark.asyncio
+async def test_wire_json_response(api_url: str) -> None:
+    """Test that a binary request without a binary Accept header gets a JSON response."""
+    model_name = await helpers.get_model_name(api_url, program_code)
+    url = f"{api_url}/{model_name}/log_prob"
+    body = wire.encode(json.dumps({"data": data, "adjust_transform": False}).encode(), {"unconstrained_parameters": z})
+    async with aiohttp.ClientSession() as session:
+        async with session.post(url, data=body, headers={"Content-Type": wire.MEDIA_TYPE}) as resp:
+            assert resp.status == 200
+            assert np.allclose((await resp.json())["log_prob"], -0.5 * (z ** 2).sum())
+
+
+@pytest.mark.asyncio
+async def test_wire_invalid_requests(api_url: str) -> None:
+    model_name = await helpers.get_model_name(api_url, program_code)
+    url = f"{api_url}/{model_name}/log_prob"
+    # missing array
+    status, _, body = await _post(url, {"data": data}, {})
+    assert status == 422
+    assert "unconstrained_parameters" in json.loads(body)["json"]
+    # unexpected array
+    status, _, body = await _post(url, {"data": data}, {"unconstrained_parameters": z, "extra": z})
+    assert status == 400
+    # wrong number of dimensions
+    status, _, body = await _post(url, {"data": data}, {"unconstrained_parameters": np.stack([z, z])})
+    assert status == 400
+    assert "one-dimensional" in json.loads(body)["message"]
+    # not a message
+    headers = {"Content-Type": wire.MEDIA_TYPE}
+    async with aiohttp.ClientSession() as session:
+        async with session.post(url, data=b"not a message", headers=headers) as resp:
+            assert resp.status == 400